@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/copy.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <atomic>
+#include <new>
+
+#include <stdlib.h>
+
+// Counts every allocation made by the benchmark binary.
+// Replacing the global operators affects the whole program, so these
+// benchmarks are built as a binary of their own (mms_alloc_bench).
+// The operators are kept out of line, so that the compiler does not
+// pair malloc() in one with free() in another as a mismatch.
+static std::atomic<size_t> g_allocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++g_allocations;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+template<class P>
+struct Leaf {
+    int id;
+    mms::string<P> name;
+    mms::vector<P, int> refs;
+
+    template<class A> void traverseFields(A a) const { a(id)(name)(refs); }
+};
+
+template<class P>
+struct Node {
+    int id;
+    Leaf<P> leaf;
+    mms::vector<P, Leaf<P> > leaves;
+
+    template<class A> void traverseFields(A a) const { a(id)(leaf)(leaves); }
+};
+
+template<class T>
+void measure(const T& t, size_t elements)
+{
+    // Warm up buffers (and static data) first, so that only
+    // allocations made by writing itself are counted.
+    mms::BufferWriter w;
+    mms::safeWrite(w, t);
+
+    const size_t iterations = 10;
+    size_t before = g_allocations;
+    bench::Timer timer;
+    for (size_t i = 0; i != iterations; ++i) {
+        w.clear();
+        mms::safeWrite(w, t);
+    }
+    double time = timer.seconds();
+    size_t allocations = (g_allocations - before) / iterations;
+
+    bench::report("allocations per write", allocations, "");
+    bench::report("allocations per element", double(allocations) / elements, "");
+    bench::report("time per write", time / iterations, "s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(alloc_vector_of_structs)
+{
+    mms::vector< mms::Standalone, Node<mms::Standalone> > v;
+    size_t size = 100000 * bench::scale();
+    for (size_t i = 0; i != size; ++i) {
+        v.push_back(Node<mms::Standalone>());
+        Node<mms::Standalone>& n = v.back();
+        n.id = i;
+        n.leaf.name = "leaf";
+        n.leaves.resize(i % 4);
+    }
+    measure(v, size);
+}
+
+MMS_BENCHMARK(alloc_map)
+{
+    mms::map< mms::Standalone, int, Leaf<mms::Standalone> > m;
+    size_t size = 100000 * bench::scale();
+    for (size_t i = 0; i != size; ++i) {
+        m[i].name = "leaf";
+        m[i].refs.assign(i % 3, i);
+    }
+    measure(m, size);
+}
+
+MMS_BENCHMARK(alloc_copy)
+{
+    typedef mms::vector< mms::Standalone, Leaf<mms::Standalone> > Vector;
+    Vector v(100000 * bench::scale());
+    for (size_t i = 0; i != v.size(); ++i)
+        v[i].id = i;
+
+    mms::BufferWriter w;
+    mms::safeWrite(w, v);
+    const Vector::MmappedType& mm = w.safeCast<Vector::MmappedType>();
+
+    Vector copy;
+    mms::copy(mm, copy);
+    size_t before = g_allocations;
+    bench::Timer timer;
+    mms::copy(mm, copy);
+    double time = timer.seconds();
+
+    bench::report("allocations per element", double(g_allocations - before) / v.size(), "");
+    bench::report("time", time, "s");
+}
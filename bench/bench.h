@@ -0,0 +1,107 @@
+/*
+ * bench/bench.h -- a tiny harness for mms benchmarks
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <stdlib.h>
+#include <time.h>
+
+namespace bench {
+
+typedef void (*Function)();
+
+typedef std::vector< std::pair<std::string, Function> > Registry;
+
+inline Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+struct Registrar {
+    Registrar(const char* name, Function fn)
+    {
+        registry().push_back(std::make_pair(std::string(name), fn));
+    }
+};
+
+/// Size multiplier for all benchmarks (MMS_BENCH_SCALE, default 1).
+inline size_t scale()
+{
+    const char* s = getenv("MMS_BENCH_SCALE");
+    return (s && atoi(s) > 0) ? atoi(s) : 1;
+}
+
+class Timer {
+public:
+    Timer() { reset(); }
+    void reset() { start_ = now(); }
+    double seconds() const { return now() - start_; }
+
+private:
+    double start_;
+
+    static double now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+};
+
+inline void report(const std::string& what, double value, const char* unit)
+{
+    std::cout << "    " << what << ": " << value << " " << unit << std::endl;
+}
+
+/// An output stream which discards everything written to it,
+/// so that benchmarks measure serialization rather than I/O.
+class NullStream: public std::ostream {
+public:
+    NullStream(): std::ostream(&buf_) {}
+
+private:
+    class Buf: public std::streambuf {
+    protected:
+        int overflow(int c) { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char*, std::streamsize n) { return n; }
+    };
+    Buf buf_;
+};
+
+} // namespace bench
+
+#define MMS_BENCHMARK(name) \
+    static void bench_##name(); \
+    static ::bench::Registrar bench_registrar_##name(#name, &bench_##name); \
+    static void bench_##name()
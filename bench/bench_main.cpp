@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <cstring>
+
+// Usage: mms_bench [substring...]
+// Runs all benchmarks whose names contain any of given substrings
+// (or all of them if none given).
+int main(int argc, char** argv)
+{
+    const bench::Registry& r = bench::registry();
+    for (bench::Registry::const_iterator i = r.begin(), ie = r.end(); i != ie; ++i) {
+        bool selected = (argc == 1);
+        for (int arg = 1; arg != argc && !selected; ++arg)
+            selected = (i->first.find(argv[arg]) != std::string::npos);
+        if (!selected)
+            continue;
+
+        std::cout << i->first << ":" << std::endl;
+        i->second();
+    }
+    return 0;
+}
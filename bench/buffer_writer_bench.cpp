@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+
+namespace {
+
+typedef mms::map< mms::Standalone, int, mms::string<mms::Standalone> > Map;
+typedef mms::map< mms::Mmapped, int, mms::string<mms::Mmapped> > MmappedMap;
+
+// Mimics a cache serializing lots of small objects
+// and casting them right back.
+Map genMap(size_t size)
+{
+    Map m;
+    for (size_t i = 0; i != size; ++i) {
+        std::ostringstream s;
+        s << "value #" << i;
+        m[i] = s.str();
+    }
+    return m;
+}
+
+} // namespace
+
+MMS_BENCHMARK(buffer_writer_small_objects)
+{
+    Map m = genMap(16);
+    size_t iterations = 100000 * bench::scale();
+    size_t checksum = 0;
+
+    bench::Timer timer;
+    for (size_t i = 0; i != iterations; ++i) {
+        std::stringstream s;
+        mms::safeWrite(s, m);
+        std::string buf = s.str();
+        checksum += mms::safeCast<MmappedMap>(buf.data(), buf.size()).size();
+    }
+    double stream = timer.seconds();
+
+    timer.reset();
+    mms::BufferWriter w;
+    for (size_t i = 0; i != iterations; ++i) {
+        w.clear();
+        mms::safeWrite(w, m);
+        checksum += w.safeCast<MmappedMap>().size();
+    }
+    double buffer = timer.seconds();
+
+    bench::report("std::stringstream", stream, "s");
+    bench::report("mms::BufferWriter", buffer, "s");
+    bench::report("speedup", stream / buffer, "x");
+    bench::report("checksum", checksum, "");
+}
+
+MMS_BENCHMARK(buffer_writer_large_object)
+{
+    Map m = genMap(1000000 * bench::scale());
+
+    bench::Timer timer;
+    std::stringstream s;
+    mms::safeWrite(s, m);
+    std::string buf = s.str();
+    double stream = timer.seconds();
+
+    timer.reset();
+    mms::BufferWriter w;
+    mms::safeWrite(w, m);
+    double buffer = timer.seconds();
+
+    bench::report("std::stringstream", stream, "s");
+    bench::report("mms::BufferWriter", buffer, "s");
+    bench::report("speedup", stream / buffer, "x");
+}
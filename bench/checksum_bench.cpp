@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/checksum.h>
+#include <mms/buffer_writer.h>
+#include <mms/vector.h>
+
+#include <sstream>
+#include <thread>
+
+namespace {
+
+typedef mms::vector<mms::Standalone, uint64_t> Vector;
+
+void reportSpeed(const char* what, size_t bytes, double seconds)
+{
+    bench::report(what, bytes / seconds / 1e9, "GB/s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(checksum_crc32c)
+{
+    std::string data(256 << 20, 'x');
+    for (size_t i = 0; i != data.size(); i += 64)
+        data[i] = static_cast<char>(i / 64);
+
+    bench::Timer timer;
+    uint32_t sw = ~mms::impl::crc32cSoftware(~0u, data.data(), data.size());
+    reportSpeed("software", data.size(), timer.seconds());
+
+    timer.reset();
+    uint32_t hw = mms::impl::crc32c(0, data.data(), data.size());
+    reportSpeed(mms::impl::hasHardwareCrc32c() ? "sse4.2" : "default", data.size(), timer.seconds());
+    if (sw != hw)
+        std::cerr << "checksum mismatch!" << std::endl;
+}
+
+MMS_BENCHMARK(checksum_write_and_verify)
+{
+    Vector v;
+    for (size_t i = 0, ie = (32 << 20) * bench::scale(); i != ie; ++i)
+        v.push_back(i * 2654435761u);
+
+    mms::BufferWriter plain;
+    bench::Timer timer;
+    mms::safeWrite(plain, v);
+    double plainTime = timer.seconds();
+
+    mms::BufferWriter checked;
+    timer.reset();
+    mms::checksummedWrite(checked, v);
+    double checkedTime = timer.seconds();
+
+    bench::report("safeWrite()", plainTime, "s");
+    bench::report("checksummedWrite()", checkedTime, "s");
+
+    size_t cpus = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    for (size_t threads = 1; threads <= cpus; threads *= 2) {
+        timer.reset();
+        mms::Checksums c(checked.data(), checked.size());
+        c.verify(threads);
+        std::ostringstream what;
+        what << "verify(), " << threads << " thread(s)";
+        reportSpeed(what.str().c_str(), c.dataSize(), timer.seconds());
+    }
+}
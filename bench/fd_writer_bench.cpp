@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/fd_writer.h>
+#include <mms/async_writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+std::string tempName()
+{
+    char name[] = "/tmp/mms_bench.XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    return name;
+}
+
+template<class T>
+void compare(const T& t)
+{
+    std::string name = tempName();
+
+    bench::Timer timer;
+    {
+        std::ofstream out(name.c_str());
+        mms::safeWrite(out, t);
+    }
+    double stream = timer.seconds();
+
+    timer.reset();
+    {
+        int fd = open(name.c_str(), O_WRONLY | O_TRUNC);
+        mms::FdWriter w(fd);
+        mms::safeWrite(w, t);
+        w.flush();
+        close(fd);
+    }
+    double fdWriter = timer.seconds();
+
+    timer.reset();
+    mms::AsyncFdWriter::Stats stats;
+    {
+        int fd = open(name.c_str(), O_WRONLY | O_TRUNC);
+        mms::AsyncFdWriter w(fd);
+        mms::safeWrite(w, t);
+        w.flush();
+        stats = w.stats();
+        close(fd);
+    }
+    double asyncWriter = timer.seconds();
+    unlink(name.c_str());
+
+    bench::report("std::ofstream", stream, "s");
+    bench::report("mms::FdWriter", fdWriter, "s");
+    bench::report("speedup", stream / fdWriter, "x");
+    bench::report("mms::AsyncFdWriter", asyncWriter, "s");
+    bench::report("  max flush latency", stats.maxFlushSeconds, "s");
+    bench::report("  writer stalled", stats.stallSeconds, "s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(fd_writer_map)
+{
+    mms::map<mms::Standalone, int, mms::vector<mms::Standalone, int> > m;
+    for (size_t i = 0, ie = 1000000 * bench::scale(); i != ie; ++i)
+        m[i].assign(i % 4, i);
+    compare(m);
+}
+
+MMS_BENCHMARK(fd_writer_strings)
+{
+    mms::vector< mms::Standalone, mms::string<mms::Standalone> > v;
+    for (size_t i = 0, ie = 1000000 * bench::scale(); i != ie; ++i) {
+        std::ostringstream s;
+        s << "string #" << i;
+        v.push_back(s.str());
+    }
+    compare(v);
+}
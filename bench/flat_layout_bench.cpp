@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/copy.h>
+#include <mms/vector.h>
+
+namespace {
+
+template<class P>
+struct Point {
+    int x;
+    int y;
+    double weight;
+
+    template<class A> void traverseFields(A a) const { a(x)(y)(weight); }
+};
+
+// Same layout, but not trivially copyable, so written field by field
+template<class P>
+struct FieldwisePoint {
+    int x;
+    int y;
+    double weight;
+
+    FieldwisePoint(): x(0), y(0), weight(0) {}
+    FieldwisePoint(const FieldwisePoint& p): x(p.x), y(p.y), weight(p.weight) {}
+
+    template<class A> void traverseFields(A a) const { a(x)(y)(weight); }
+};
+
+template<template<class> class Pt>
+void run(const char* name, size_t size)
+{
+    mms::vector< mms::Standalone, Pt<mms::Standalone> > v(size);
+    for (size_t i = 0; i != size; ++i) {
+        v[i].x = i;
+        v[i].y = -i;
+        v[i].weight = i * 0.5;
+    }
+
+    mms::BufferWriter w;
+    bench::Timer timer;
+    mms::write(w, v);
+    double writeTime = timer.seconds();
+
+    const mms::vector< mms::Mmapped, Pt<mms::Mmapped> >& mm =
+        mms::cast< mms::vector< mms::Mmapped, Pt<mms::Mmapped> > >(w.data(), w.size());
+    timer.reset();
+    mms::vector< mms::Standalone, Pt<mms::Standalone> > copy(mm);
+    double copyTime = timer.seconds();
+
+    bench::report(std::string(name) + " write", size * sizeof(v[0]) / writeTime / 1e9, "GB/s");
+    bench::report(std::string(name) + " copy", size * sizeof(v[0]) / copyTime / 1e9, "GB/s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(flat_layout)
+{
+    size_t size = 10000000 * bench::scale();
+    run<FieldwisePoint>("field by field", size);
+    run<Point>("flat", size);
+}
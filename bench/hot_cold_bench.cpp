@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <mms/compact.h>
+#include <mms/mapped_file.h>
+#include <mms/fd_writer.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+template<class P>
+struct Item {
+    int id;
+    mms::string<P> key;
+    mms::string<P> description;
+    mms::vector<P, int> history;
+
+    template<class A> void traverseFields(A a) const
+    {
+        a(id)(mms::field("key", key))(mms::field("description", description))
+            (mms::field("history", history));
+    }
+};
+
+// Items sorted by key; lookups only ever read keys and ids.
+template<class P>
+struct Catalog {
+    mms::vector< P, Item<P> > items;
+
+    template<class A> void traverseFields(A a) const { a(mms::field("items", items)); }
+};
+
+typedef Catalog<mms::Mmapped> MmCatalog;
+
+std::string key(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "item-%08d", i);
+    return buf;
+}
+
+struct KeyLess {
+    bool operator()(const Item<mms::Mmapped>& item, const std::string& k) const
+    {
+        return item.key < k;
+    }
+};
+
+void write(const std::string& path, const Catalog<mms::Standalone>& c, const mms::AccessProfile* profile)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    mms::FdWriter w(fd);
+    if (profile)
+        mms::safeWrite(w, c, *profile);
+    else
+        mms::safeWrite(w, c);
+    w.flush();
+    fdatasync(fd);
+    close(fd);
+}
+
+size_t residentPages(const mms::FileMapping& m)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> pages((m.size() + page - 1) / page);
+    mincore(const_cast<char*>(m.data()), m.size(), &pages[0]);
+    size_t resident = 0;
+    for (size_t i = 0; i != pages.size(); ++i)
+        resident += pages[i] & 1;
+    return resident;
+}
+
+void run(const std::string& name, const std::string& path, int items, int queries)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    // No readahead, so that only pages actually read become resident
+    mms::MappedFile<MmCatalog> c(path, mms::MapPolicy().advise(mms::MapPolicy::Random));
+    srand(42);
+    bench::Timer timer;
+    int hits = 0;
+    for (int i = 0; i != queries; ++i) {
+        // Every other key is absent
+        std::string k = key(rand() % (items * 2));
+        const Item<mms::Mmapped>* it = std::lower_bound(
+            c->items.begin(), c->items.end(), k, KeyLess());
+        if (it != c->items.end() && it->key == k)
+            hits += (it->id >= 0);
+    }
+    double seconds = timer.seconds();
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    std::cout << "  " << name << ":" << std::endl;
+    bench::report("  file", c.size() / 1048576.0, "MB");
+    bench::report("  hit rate", 100.0 * hits / queries, "%");
+    bench::report("  resident", residentPages(c) * page / 1048576.0, "MB");
+    bench::report("  lookups", seconds, "s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(hot_cold_layout)
+{
+    const char* dir = getenv("MMS_BENCH_DIR");
+    std::string path = std::string(dir ? dir : ".") + "/mms_bench_hot_cold.mms";
+    const int items = 500000 * bench::scale();
+    const int queries = 100000;
+
+    Catalog<mms::Standalone> c;
+    c.items.resize(items);
+    for (int i = 0; i != items; ++i) {
+        Item<mms::Standalone>& item = c.items[i];
+        item.id = i * 2;
+        item.key = key(i * 2);
+        item.description = std::string(160, 'a' + i % 26);
+        item.history.assign(8, i);
+    }
+
+    write(path, c, 0);
+    run("as written", path, items, queries);
+
+    // Lookups only read bodies of items (hot as a prefix) and their keys
+    mms::AccessProfile profile;
+    profile.hot("items[].key");
+    write(path, c, &profile);
+    run("keys hot", path, items, queries);
+    unlink(path.c_str());
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Record {
+    int id;
+    double weight;
+    mms::string<P> name;
+    mms::vector<P, int> tags;
+
+    template<class A> void traverseFields(A a) const { a(id)(weight)(name)(tags); }
+};
+
+std::string genName(size_t i)
+{
+    std::ostringstream s;
+    s << "record #" << i * 2654435761u;
+    return s.str();
+}
+
+// Writes `t' the way safeWrite() used to: always running
+// the layout pass first.
+template<class T>
+void twoPassWrite(std::ostream& out, const T& t)
+{
+    mms::Writer w(out);
+    mms::impl::layOut(w, t, true);
+    mms::impl::write(w, t, true);
+}
+
+template<class T>
+void compare(const T& t)
+{
+    bench::NullStream out;
+    bench::Timer timer;
+    twoPassWrite(out, t);
+    double twoPass = timer.seconds();
+
+    timer.reset();
+    mms::safeWrite(out, t);
+    double onePass = timer.seconds();
+
+    bench::report("with layout pass", twoPass, "s");
+    bench::report("single pass", onePass, "s");
+    bench::report("speedup", twoPass / onePass, "x");
+}
+
+} // namespace
+
+MMS_BENCHMARK(layout_skip_map)
+{
+    mms::map<mms::Standalone, mms::string<mms::Standalone>, int> m;
+    for (size_t i = 0, ie = 1000000 * bench::scale(); i != ie; ++i)
+        m[genName(i)] = i;
+    compare(m);
+}
+
+MMS_BENCHMARK(layout_skip_vector)
+{
+    mms::vector< mms::Standalone, Record<mms::Standalone> > v(1000000 * bench::scale());
+    for (size_t i = 0; i != v.size(); ++i) {
+        v[i].id = i;
+        v[i].weight = i * 0.5;
+        v[i].name = genName(i);
+        v[i].tags.assign(i % 8, i);
+    }
+    compare(v);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <mms/mapped_file.h>
+#include <mms/fd_writer.h>
+#include <mms/writer.h>
+#include <mms/map.h>
+#include <mms/string.h>
+
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+typedef mms::map< mms::Standalone, int, mms::string<mms::Standalone> > Map;
+typedef mms::map< mms::Mmapped, int, mms::string<mms::Mmapped> > MmMap;
+
+// Evicts `path' from the page cache and returns the fraction
+// of it which is still resident (nonzero on tmpfs, say).
+double dropCache(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    off_t size = lseek(fd, 0, SEEK_END);
+    void* p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> pages((size + page - 1) / page);
+    mincore(p, size, &pages[0]);
+    munmap(p, size);
+    size_t resident = 0;
+    for (size_t i = 0; i != pages.size(); ++i)
+        resident += pages[i] & 1;
+    return double(resident) / pages.size();
+}
+
+void coldStart(const std::string& name, const std::string& path, int keys, const mms::MapPolicy& policy)
+{
+    double resident = dropCache(path);
+
+    bench::Timer timer;
+    mms::MappedFile<MmMap> m(path, policy);
+    double load = timer.seconds();
+
+    const int queries = 10000;
+    srand(42);
+    timer.reset();
+    size_t found = 0;
+    double first = 0;
+    for (int i = 0; i != queries; ++i) {
+        found += m->find(rand() % keys) != m->end();
+        if (i == 0)
+            first = timer.seconds();
+    }
+    double query = timer.seconds();
+
+    std::cout << "  " << name << " (" << int(resident * 100) << "% cached before):" << std::endl;
+    bench::report("  load", load, "s");
+    bench::report("  first query", first * 1e6, "us");
+    bench::report("  mean query", query / queries * 1e6, "us");
+    bench::report("  load + queries", load + query, "s");
+    if (found != queries)
+        std::cout << "    MISMATCH: found " << found << " of " << queries << std::endl;
+}
+
+} // namespace
+
+MMS_BENCHMARK(mapped_file_cold_start)
+{
+    const char* dir = getenv("MMS_BENCH_DIR");
+    std::string path = std::string(dir ? dir : ".") + "/mms_bench_mapped_file.mms";
+    const int keys = 2000000 * bench::scale();
+    {
+        Map m;
+        for (int i = 0; i != keys; ++i) {
+            std::ostringstream s;
+            s << "value #" << i;
+            m[i] = s.str();
+        }
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        mms::FdWriter w(fd);
+        mms::safeWrite(w, m);
+        w.flush();
+        fdatasync(fd);
+        close(fd);
+    }
+
+    typedef mms::MapPolicy P;
+    coldStart("default", path, keys, P());
+    coldStart("MADV_RANDOM", path, keys, P().advise(P::Random));
+    coldStart("MADV_SEQUENTIAL", path, keys, P().advise(P::Sequential));
+    coldStart("MADV_WILLNEED", path, keys, P().advise(P::WillNeed));
+    coldStart("MAP_POPULATE", path, keys, P().populate());
+    coldStart("huge pages", path, keys, P().hugePages());
+    coldStart("mlock", path, keys, P().lock());
+    coldStart("private + MAP_POPULATE", path, keys, P().privateWritable().populate());
+    unlink(path.c_str());
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <mms/buffer_writer.h>
+#include <mms/memfd.h>
+#include <mms/mmap_file_writer.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace {
+
+typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > MmStrings;
+
+size_t consume(const MmStrings& v)
+{
+    size_t sum = 0;
+    for (MmStrings::const_iterator i = v.begin(), ie = v.end(); i != ie; ++i)
+        sum += i->size() + (i->empty() ? 0 : (*i)[0]);
+    return sum;
+}
+
+// Runs `consumer' in a child process, which gets handed each snapshot
+// over a UNIX socket and replies once it has read all of it.
+class Consumer {
+public:
+    explicit Consumer(void (*serve)(int sock))
+    {
+        int socks[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) != 0)
+            abort();
+        pid_ = fork();
+        if (pid_ == 0) {
+            close(socks[0]);
+            serve(socks[1]);
+            _exit(0);
+        }
+        close(socks[1]);
+        sock_ = socks[0];
+    }
+
+    ~Consumer()
+    {
+        close(sock_);
+        waitpid(pid_, 0, 0);
+    }
+
+    int socket() const { return sock_; }
+
+    size_t wait()
+    {
+        size_t sum = 0;
+        if (read(sock_, &sum, sizeof(sum)) != sizeof(sum))
+            abort();
+        return sum;
+    }
+
+private:
+    pid_t pid_;
+    int sock_;
+};
+
+void reply(int sock, size_t sum)
+{
+    if (write(sock, &sum, sizeof(sum)) != sizeof(sum))
+        abort();
+}
+
+void serveFiles(int sock)
+{
+    char path[256];
+    ssize_t len;
+    while ((len = read(sock, path, sizeof(path) - 1)) > 0) {
+        path[len] = 0;
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        fstat(fd, &st);
+        void* p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        reply(sock, consume(mms::safeCast<MmStrings>(static_cast<const char*>(p), st.st_size)));
+        munmap(p, st.st_size);
+    }
+}
+
+void serveMemfds(int sock)
+{
+    for (;;) {
+        int fd;
+        try { fd = mms::receiveFd(sock); }
+        catch (std::exception&) { return; }
+        mms::SealedMapping m(fd);
+        reply(sock, consume(m.safeCast<MmStrings>()));
+    }
+}
+
+} // namespace
+
+MMS_BENCHMARK(memfd_distribution)
+{
+    Strings v;
+    for (size_t i = 0, ie = 2000000 * bench::scale(); i != ie; ++i) {
+        std::ostringstream s;
+        s << "string #" << i;
+        v.push_back(s.str());
+    }
+    const size_t rounds = 5;
+    std::string path = "/tmp/mms_bench_memfd.mms";
+    size_t expected = 0, actual = 0;
+    {
+        mms::BufferWriter w;
+        mms::safeWrite(w, v);
+        expected = consume(w.safeCast<MmStrings>());
+    }
+
+    double stream = 0, streamTotal = 0;
+    {
+        Consumer c(&serveFiles);
+        for (size_t r = 0; r != rounds; ++r) {
+            bench::Timer timer;
+            {
+                std::ofstream out(path.c_str());
+                mms::safeWrite(out, v);
+            }
+            stream += timer.seconds();
+            if (write(c.socket(), path.data(), path.size()) != (ssize_t) path.size())
+                abort();
+            actual = c.wait();
+            streamTotal += timer.seconds();
+        }
+    }
+
+    double file = 0, fileTotal = 0;
+    {
+        Consumer c(&serveFiles);
+        for (size_t r = 0; r != rounds; ++r) {
+            bench::Timer timer;
+            {
+                mms::MmapFileWriter w(path);
+                mms::safeWrite(w, v);
+                w.commit(/*sync =*/ false);
+            }
+            file += timer.seconds();
+            if (write(c.socket(), path.data(), path.size()) != (ssize_t) path.size())
+                abort();
+            actual = c.wait();
+            fileTotal += timer.seconds();
+        }
+    }
+    unlink(path.c_str());
+
+    double memfd = 0, memfdTotal = 0;
+    {
+        Consumer c(&serveMemfds);
+        for (size_t r = 0; r != rounds; ++r) {
+            bench::Timer timer;
+            int fd = mms::publish(v);
+            memfd += timer.seconds();
+            mms::sendFd(c.socket(), fd);
+            close(fd);
+            actual = c.wait();
+            memfdTotal += timer.seconds();
+        }
+    }
+
+    if (actual != expected)
+        std::cout << "    MISMATCH: " << actual << " != " << expected << std::endl;
+    bench::report("std::ofstream + mmap: publish", stream / rounds, "s");
+    bench::report("std::ofstream + mmap: consumed", streamTotal / rounds, "s");
+    bench::report("mms::MmapFileWriter: publish", file / rounds, "s");
+    bench::report("mms::MmapFileWriter: consumed", fileTotal / rounds, "s");
+    bench::report("mms::publish (memfd): publish", memfd / rounds, "s");
+    bench::report("mms::publish (memfd): consumed", memfdTotal / rounds, "s");
+    bench::report("speedup over std::ofstream", streamTotal / memfdTotal, "x");
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+#include <thread>
+
+namespace {
+
+template<class P>
+struct Record {
+    int id;
+    mms::string<P> name;
+    mms::vector<P, int> refs;
+
+    template<class A> void traverseFields(A a) const { a(id)(name)(refs); }
+};
+
+typedef mms::map< mms::Standalone, mms::string<mms::Standalone>, Record<mms::Standalone> > Map;
+
+} // namespace
+
+MMS_BENCHMARK(parallel_write_map)
+{
+    Map m;
+    for (size_t i = 0, ie = 1000000 * bench::scale(); i != ie; ++i) {
+        std::ostringstream s;
+        s << "key #" << i;
+        Record<mms::Standalone>& r = m[s.str()];
+        r.id = i;
+        r.name = std::string(i % 30, 'a' + i % 26);
+        r.refs.assign(i % 8, i);
+    }
+
+    mms::BufferWriter single;
+    bench::Timer timer;
+    mms::safeWrite(single, m);
+    double singleTime = timer.seconds();
+
+    size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    mms::BufferWriter parallel;
+    parallel.setThreads(threads);
+    timer.reset();
+    mms::safeWrite(parallel, m);
+    double parallelTime = timer.seconds();
+
+    bench::report("threads", threads, "");
+    bench::report("1 thread", singleTime, "s");
+    bench::report("N threads", parallelTime, "s");
+    bench::report("speedup", singleTime / parallelTime, "x");
+    bench::report("identical", single.size() == parallel.size()
+        && std::equal(single.data(), single.data() + single.size(), parallel.data()), "");
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <mms/mapped_file.h>
+#include <mms/fd_writer.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+typedef mms::vector<mms::Standalone, uint64_t> Blob;
+typedef mms::vector<mms::Mmapped, uint64_t> MmBlob;
+
+void timeToResident(const std::string& name, const std::string& path, const mms::MapPolicy& policy)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    mms::MappedFile<MmBlob> m(path, policy);
+    std::cout << "  " << name << ":" << std::endl;
+    bench::report("  time to resident", m.loadSeconds(), "s");
+    bench::report("  throughput", m.size() / m.loadSeconds() / 1048576, "MB/s");
+}
+
+} // namespace
+
+MMS_BENCHMARK(prefault_loader)
+{
+    const char* dir = getenv("MMS_BENCH_DIR");
+    std::string path = std::string(dir ? dir : ".") + "/mms_bench_prefault.mms";
+    {
+        Blob blob(32 * 1048576 * bench::scale());
+        for (size_t i = 0; i != blob.size(); ++i)
+            blob[i] = i * 2654435761u;
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        mms::FdWriter w(fd);
+        mms::safeWrite(w, blob);
+        w.flush();
+        fdatasync(fd);
+        close(fd);
+    }
+
+    typedef mms::MapPolicy P;
+    timeToResident("MAP_POPULATE", path, P().populate());
+    timeToResident("prefault, 1 thread", path, P().prefault(1));
+    timeToResident("prefault, 2 threads", path, P().prefault(2));
+    timeToResident("prefault, 4 threads", path, P().prefault(4));
+    timeToResident("prefault, 8 threads", path, P().prefault(8));
+    timeToResident("prefault, 8 threads, NUMA", path, P().prefault(8).numaNodes());
+    timeToResident("prefault, 8 threads, 200 MB/s", path, P().prefault(8).bandwidth(200 << 20));
+    unlink(path.c_str());
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <mms/prefetch.h>
+#include <mms/mapped_file.h>
+#include <mms/fd_writer.h>
+#include <mms/writer.h>
+#include <mms/unordered_map.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+template<class P>
+struct Index {
+    mms::unordered_map<P, int, int> lookup;
+    mms::vector< P, mms::string<P> > payload;
+
+    template<class A> void traverseFields(A a) const { a(lookup)(payload); }
+};
+
+void dropCache(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+void run(const std::string& name, const std::string& path, int keys,
+    const mms::PrefetchPolicy* policy)
+{
+    dropCache(path);
+    mms::MappedFile< Index<mms::Mmapped> > idx(path);
+
+    bench::Timer timer;
+    mms::PrefetchStats stats;
+    if (policy)
+        stats = mms::prefetch(*idx, *policy);
+    double warm = timer.seconds();
+
+    const int queries = 100000;
+    srand(42);
+    timer.reset();
+    size_t sum = 0;
+    for (int i = 0; i != queries; ++i)
+        sum += idx->lookup[rand() % keys];
+    double query = timer.seconds();
+
+    std::cout << "  " << name << ":" << std::endl;
+    if (policy) {
+        bench::report("  warmed", stats.bytes / 1048576.0, "MB");
+        bench::report("  warmup", warm, "s");
+    }
+    bench::report("  lookups", query, "s");
+    bench::report("  mean lookup", query / queries * 1e6, "us");
+    if (!sum)
+        std::cout << "    (no hits)" << std::endl;
+}
+
+} // namespace
+
+MMS_BENCHMARK(prefetch_index)
+{
+    const char* dir = getenv("MMS_BENCH_DIR");
+    std::string path = std::string(dir ? dir : ".") + "/mms_bench_prefetch.mms";
+    const int keys = 1000000 * bench::scale();
+    {
+        Index<mms::Standalone> idx;
+        for (int i = 0; i != keys; ++i) {
+            idx.lookup[i] = i + 1;
+            idx.payload.push_back(std::string(200, 'a' + i % 26));
+        }
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        mms::FdWriter w(fd);
+        mms::safeWrite(w, idx);
+        w.flush();
+        fdatasync(fd);
+        close(fd);
+    }
+
+    typedef mms::PrefetchPolicy P;
+    const P lookupOnly = P().depth(1);
+    const P lookupOnly4 = P().depth(1).threads(4);
+    const P everything = P();
+    const P everything4 = P().threads(4);
+    const P advise = P().depth(1).method(mms::PrefetchAdvise);
+    run("cold", path, keys, 0);
+    run("depth 1, touch", path, keys, &lookupOnly);
+    run("depth 1, touch, 4 threads", path, keys, &lookupOnly4);
+    run("depth 1, MADV_WILLNEED", path, keys, &advise);
+    run("everything, touch", path, keys, &everything);
+    run("everything, touch, 4 threads", path, keys, &everything4);
+    unlink(path.c_str());
+}
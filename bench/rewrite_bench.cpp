@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/copy.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Record {
+    int id;
+    mms::string<P> name;
+    mms::vector<P, int> values;
+
+    template<class A> void traverseFields(A a) const { a(id)(name)(values); }
+};
+
+} // namespace
+
+MMS_BENCHMARK(rewrite_mmapped)
+{
+    typedef mms::vector< mms::Standalone, Record<mms::Standalone> > Records;
+    typedef mms::vector< mms::Mmapped, Record<mms::Mmapped> > MmappedRecords;
+
+    Records src(1000000 * bench::scale());
+    for (size_t i = 0; i != src.size(); ++i) {
+        std::ostringstream name;
+        name << "record #" << i;
+        src[i].id = i;
+        src[i].name = name.str();
+        src[i].values.assign(i % 32, i);
+    }
+    mms::BufferWriter old;
+    mms::write(old, src);
+    Records().swap(src);
+    const MmappedRecords& mm = old.safeCast<MmappedRecords>();
+
+    bench::Timer timer;
+    {
+        mms::BufferWriter w;
+        w.write(old.data(), old.size());
+    }
+    double memcpyTime = timer.seconds();
+
+    timer.reset();
+    {
+        Records copy(mm);
+        mms::BufferWriter w;
+        mms::write(w, copy);
+    }
+    double roundTrip = timer.seconds();
+
+    timer.reset();
+    mms::BufferWriter w;
+    mms::write(w, mm);
+    double direct = timer.seconds();
+
+    bench::report("memcpy() of the same size", memcpyTime, "s");
+    bench::report("copy to Standalone and write", roundTrip, "s");
+    bench::report("write Mmapped", direct, "s");
+    bench::report("write Mmapped", old.size() / direct / 1e9, "GB/s");
+}
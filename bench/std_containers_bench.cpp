@@ -1,7 +1,4 @@
-
 /*
- * impl/front_remove_iterator.h
- *
  * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
  *
  * This file is part of mms, the memory-mapped storage library.
@@ -26,37 +23,42 @@
  */
 
 
-#pragma once
 
-#include <iterator>
+#include "bench.h"
 
-namespace mms {
+#include <mms/writer.h>
+#include <mms/std.h>
 
-// An opposite class to std::back_insert_iterator.
-template<class Container>
-class front_remove_iterator: public std::iterator<std::input_iterator_tag, typename Container::value_type> {
-public:
-    front_remove_iterator(): container_() {}
-    explicit front_remove_iterator(Container& c): container_(&c) {}
+#include <sstream>
 
-    front_remove_iterator<Container>& operator++()
-    {
-        container_->pop_front();
-        return *this;
+MMS_BENCHMARK(std_containers)
+{
+    std::map< std::string, std::vector<int> > m;
+    for (size_t i = 0, ie = 1000000 * bench::scale(); i != ie; ++i) {
+        std::ostringstream key;
+        key << "key #" << i * 2654435761u;
+        m[key.str()].assign(i % 16, i);
     }
-    
-    typename Container::value_type& operator*() const { return container_->front(); }
-    typename Container::value_type* operator->() const { return &**this; }
 
-    bool operator == (const front_remove_iterator<Container>& other) const { return at_end() && other.at_end(); }
-    bool operator != (const front_remove_iterator<Container>& other) const { return !(*this == other); }
+    typedef mms::map<
+        mms::Standalone,
+        mms::string<mms::Standalone>,
+        mms::vector<mms::Standalone, int>
+    > MmsMap;
 
-private:
-    Container* container_;
-
-    bool at_end() const { return !container_ || container_->empty(); }
+    bench::NullStream out;
+    bench::Timer timer;
+    {
+        MmsMap copy(m.begin(), m.end());
+        mms::write(out, copy);
+    }
+    double converted = timer.seconds();
 
-    void operator++(int); // not defined
-};
+    timer.reset();
+    mms::write(out, m);
+    double direct = timer.seconds();
 
-}//namespace mms
+    bench::report("copy to mms::map and write", converted, "s");
+    bench::report("write std::map", direct, "s");
+    bench::report("speedup", converted / direct, "x");
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "bench.h"
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Item {
+    int id;
+    mms::string<P> brand;
+    mms::string<P> category;
+    mms::string<P> unit;
+
+    template<class A> void traverseFields(A a) const { a(id)(brand)(category)(unit); }
+};
+
+typedef mms::vector< mms::Standalone, Item<mms::Standalone> > Catalog;
+
+Catalog genCatalog(size_t count)
+{
+    static const char* units[] = { "pcs", "kg", "l", "m", "pack of 12" };
+    Catalog c(count);
+    for (size_t i = 0; i != count; ++i) {
+        std::ostringstream brand, category;
+        brand << "Brand name #" << (i * 7919) % 2000;
+        category << "Home & Garden / Category #" << (i * 104729) % 300;
+        c[i].id = i;
+        c[i].brand = brand.str();
+        c[i].category = category.str();
+        c[i].unit = units[i % 5];
+    }
+    return c;
+}
+
+} // namespace
+
+MMS_BENCHMARK(string_interning)
+{
+    Catalog c = genCatalog(1000000 * bench::scale());
+
+    mms::BufferWriter plain;
+    bench::Timer timer;
+    mms::safeWrite(plain, c);
+    double plainTime = timer.seconds();
+
+    mms::BufferWriter interned;
+    interned.setStringInterning(true);
+    timer.reset();
+    mms::safeWrite(interned, c);
+    double internedTime = timer.seconds();
+
+    bench::report("plain size", plain.size() / 1048576.0, "MB");
+    bench::report("interned size", interned.size() / 1048576.0, "MB");
+    bench::report("size reduction", 100.0 * (1 - double(interned.size()) / plain.size()), "%");
+    bench::report("plain write", plainTime, "s");
+    bench::report("interned write", internedTime, "s");
+}
@@ -0,0 +1,370 @@
+/*
+ * mms/async_writer.h -- a writer which hands full buffers over to an I/O thread
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+#include "impl/config.h"
+
+#if !MMS_USE_CXX11
+#    error "mms/async_writer.h requires C++11"
+#endif
+
+#include "writer.h"
+#include "impl/posix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace mms {
+
+/**
+ * A writer to a raw file descriptor which overlaps serialization
+ * with disk I/O: the calling thread fills one of several large buffers
+ * while a dedicated I/O thread writes the others out. The caller only
+ * waits (stalls) when all buffers are queued for writing.
+ *
+ * With `direct' set, the descriptor is switched to O_DIRECT for the
+ * lifetime of the writer, so the page cache is bypassed. Buffers are
+ * page-aligned and their size is a multiple of a page, so full buffers
+ * go straight to the device; the unaligned tail left by flush()
+ * is written with O_DIRECT temporarily turned off and is rewritten
+ * along with whatever follows it. The current file offset of `fd'
+ * must be page-aligned in this mode. The constructor throws
+ * if the file system does not support O_DIRECT.
+ *
+ * The descriptor is not owned and is not closed. Call flush()
+ * before using the written data; it waits for the I/O thread
+ * and rethrows any error it has run into. Data the I/O thread has
+ * failed to write is lost, so once an error occurs, every subsequent
+ * write() and flush() rethrows it. The destructor flushes too,
+ * but has no way to report errors.
+ *
+ *   mms::AsyncFdWriter w(fd);
+ *   mms::safeWrite(w, obj);
+ *   w.flush();
+ *   std::cerr << w.stats().stallSeconds << std::endl;
+ */
+class AsyncFdWriter: public impl::WriterBase {
+public:
+    static const size_t ALIGNMENT = 4096;
+    static const size_t DEFAULT_BUFFER_SIZE = 8 << 20;
+    static const size_t DEFAULT_BUFFER_COUNT = 2;
+
+    struct Stats {
+        Stats():
+            flushes(0), bytesFlushed(0), flushSeconds(0), maxFlushSeconds(0),
+            stalls(0), stallSeconds(0)
+        {}
+
+        size_t flushes;          ///< buffers written by the I/O thread
+        size_t bytesFlushed;     ///< by how much they have extended the output
+        double flushSeconds;     ///< total time spent writing them
+        double maxFlushSeconds;  ///< the slowest single buffer
+        size_t stalls;           ///< times the writer waited for a free buffer
+        double stallSeconds;     ///< total time spent waiting
+    };
+
+    explicit AsyncFdWriter(
+            int fd,
+            size_t bufferSize = DEFAULT_BUFFER_SIZE,
+            size_t bufferCount = DEFAULT_BUFFER_COUNT,
+            bool direct = false
+    ):
+        fd_(fd), direct_(direct), oldFlags_(-1),
+        bufferSize_(roundUp(std::max<size_t>(bufferSize, 1))),
+        buffers_(std::max<size_t>(bufferCount, 2)),
+        current_(0), failed_(false), pending_(0), stop_(false)
+    {
+        off_t start = ::lseek(fd_, 0, SEEK_CUR);
+        if (start < 0)
+            impl::throwSystemError("mms: lseek() failed");
+        fileOfs_ = flushedOfs_ = start;
+        if (direct_ && (fileOfs_ % ALIGNMENT))
+            throw std::logic_error("mms: O_DIRECT output must start at a page boundary");
+
+        try {
+            for (Buffer& b: buffers_) {
+                void* p;
+                if (posix_memalign(&p, ALIGNMENT, bufferSize_) != 0)
+                    throw std::bad_alloc();
+                b.data = static_cast<char*>(p);
+                free_.push_back(&b);
+            }
+            current_ = free_.front();
+            free_.pop_front();
+
+            if (direct_) {
+                oldFlags_ = ::fcntl(fd_, F_GETFL);
+                if (oldFlags_ < 0 || ::fcntl(fd_, F_SETFL, oldFlags_ | O_DIRECT) < 0)
+                    impl::throwSystemError("mms: cannot enable O_DIRECT");
+            }
+
+            thread_ = std::thread([this]() { ioLoop(); });
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~AsyncFdWriter()
+    {
+        try {
+            flush();
+        }
+        catch (const std::exception&) {}
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queued_.notify_one();
+        thread_.join();
+        release();
+    }
+
+    void write(const void* data, size_t size)
+    {
+        if (failed_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rethrowError();
+        }
+        const char* p = static_cast<const char*>(data);
+        for (size_t left = size; left; ) {
+            size_t n = std::min(left, bufferSize_ - current_->used);
+            memcpy(current_->data + current_->used, p, n);
+            current_->used += n;
+            p += n;
+            left -= n;
+            if (current_->used == bufferSize_)
+                submit(bufferSize_);
+        }
+        advance(size);
+    }
+
+    /// Waits until everything written so far reaches the file
+    /// and moves the file offset of `fd' past it.
+    void flush()
+    {
+        if (current_->used) {
+            size_t aligned = direct_ ? current_->used / ALIGNMENT * ALIGNMENT : current_->used;
+            size_t tail = current_->used - aligned;
+            char tailData[ALIGNMENT];
+            memcpy(tailData, current_->data + aligned, tail);
+
+            current_->tail = tail;
+            submit(aligned);
+
+            // The tail will be rewritten with the data following it,
+            // keeping direct writes aligned.
+            memcpy(current_->data, tailData, tail);
+            current_->used = tail;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+        rethrowError();
+        lock.unlock();
+
+        if (::lseek(fd_, fileOfs_ + current_->used, SEEK_SET) < 0)
+            impl::throwSystemError("mms: lseek() failed");
+    }
+
+    /// Returns a snapshot of I/O counters.
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    int fd() const { return fd_; }
+    size_t bufferSize() const { return bufferSize_; }
+
+private:
+    struct Buffer {
+        Buffer(): data(0), used(0), tail(0), fileOfs(0) {}
+
+        char* data;
+        size_t used;
+        size_t tail;     // bytes past `used' to be written without O_DIRECT
+        off_t fileOfs;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    int fd_;
+    bool direct_;
+    int oldFlags_;
+    size_t bufferSize_;
+    std::vector<Buffer> buffers_;
+    off_t fileOfs_;                // where *current_ starts in the file
+    Buffer* current_;              // owned by the writing thread
+    std::atomic<bool> failed_;     // error_ is set; checked without locking
+
+    mutable std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable done_;
+    std::deque<Buffer*> free_;
+    std::deque<Buffer*> queue_;
+    size_t pending_;
+    bool stop_;
+    std::exception_ptr error_;     // kept once set (see rethrowError())
+    off_t flushedOfs_;             // end of data written by the I/O thread
+    Stats stats_;
+    std::thread thread_;
+
+    static size_t roundUp(size_t size) { return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+    static double since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Queues first `size' bytes of the current buffer (plus its tail)
+    // for writing and picks up a free buffer, waiting if there is none.
+    void submit(size_t size)
+    {
+        current_->used = size;
+        current_->fileOfs = fileOfs_;
+        fileOfs_ += size;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_.push_back(current_);
+        ++pending_;
+        queued_.notify_one();
+
+        if (free_.empty()) {
+            Clock::time_point start = Clock::now();
+            done_.wait(lock, [this]() { return !free_.empty(); });
+            ++stats_.stalls;
+            stats_.stallSeconds += since(start);
+        }
+        current_ = free_.front();
+        free_.pop_front();
+        current_->used = current_->tail = 0;
+        rethrowError();
+    }
+
+    // The buffer which failed is dropped, leaving a hole in the file,
+    // so the error is not cleared: nothing written afterwards is any good.
+    void rethrowError()
+    {
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+    void ioLoop()
+    {
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            Buffer* b = queue_.front();
+            queue_.pop_front();
+            bool failed = static_cast<bool>(error_);
+            lock.unlock();
+
+            Clock::time_point start = Clock::now();
+            std::exception_ptr error;
+            if (!failed) {
+                try {
+                    writeOut(*b);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            double seconds = since(start);
+
+            lock.lock();
+            if (!failed && !error) {
+                // O_DIRECT tails are written again with the next buffer,
+                // so only count what goes past the data written before.
+                off_t end = b->fileOfs + b->used + b->tail;
+                if (end > flushedOfs_) {
+                    stats_.bytesFlushed += end - flushedOfs_;
+                    flushedOfs_ = end;
+                }
+                ++stats_.flushes;
+                stats_.flushSeconds += seconds;
+                stats_.maxFlushSeconds = std::max(stats_.maxFlushSeconds, seconds);
+            }
+            if (error && !error_) {
+                error_ = error;
+                failed_ = true;
+            }
+            free_.push_back(b);
+            --pending_;
+            done_.notify_all();
+        }
+    }
+
+    void writeOut(const Buffer& b)
+    {
+        impl::pwriteAll(fd_, b.data, b.used, b.fileOfs);
+        if (b.tail) {
+            setFlags(oldFlags_);
+            impl::pwriteAll(fd_, b.data + b.used, b.tail, b.fileOfs + b.used);
+            setFlags(oldFlags_ | O_DIRECT);
+        }
+    }
+
+    void setFlags(int flags)
+    {
+        if (::fcntl(fd_, F_SETFL, flags) < 0)
+            impl::throwSystemError("mms: fcntl() failed");
+    }
+
+    void release()
+    {
+        if (direct_ && oldFlags_ >= 0)
+            ::fcntl(fd_, F_SETFL, oldFlags_);
+        for (Buffer& b: buffers_)
+            free(b.data);
+    }
+
+    AsyncFdWriter(const AsyncFdWriter&) /* = delete */;
+    AsyncFdWriter& operator = (const AsyncFdWriter&) /* = delete */;
+};
+
+} // namespace mms
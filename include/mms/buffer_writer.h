@@ -0,0 +1,116 @@
+/*
+ * mms/buffer_writer.h -- a writer to a growable in-memory buffer
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "cast.h"
+
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <stdlib.h>
+
+namespace mms {
+
+/**
+ * A writer which puts everything into a contiguous page-aligned
+ * memory buffer, which can be passed to safeCast()/unsafeCast() right away.
+ *
+ * If the layout pass is run, the buffer is allocated exactly
+ * of the size needed; otherwise it grows geometrically.
+ * clear() rewinds the writer but keeps the memory, so a writer
+ * reused for objects of similar size does not allocate at all.
+ *
+ *   mms::BufferWriter w;
+ *   mms::safeWrite(w, obj);
+ *   const Obj<mms::Mmapped>& m = w.safeCast< Obj<mms::Mmapped> >();
+ */
+class BufferWriter: public impl::WriterBase {
+public:
+    static const size_t ALIGNMENT = 4096;
+
+    BufferWriter(): data_(0), capacity_(0) {}
+    explicit BufferWriter(size_t capacity): data_(0), capacity_(0) { reserve(capacity); }
+    ~BufferWriter() { free(data_); }
+
+    void write(const void* data, size_t size)
+    {
+        if (size > capacity_ - pos())
+            grow(pos() + size);
+        memcpy(data_ + pos(), data, size);
+        advance(size);
+    }
+
+    /// Makes sure the buffer can hold `size' bytes without reallocation.
+    void reserve(size_t size)
+    {
+        if (size > capacity_)
+            reallocate(size);
+    }
+
+    /// Forgets everything written so far, but keeps allocated memory.
+    void clear() { rewind(); }
+
+    const char* data() const { return data_; }
+    size_t size() const { return pos(); }
+    size_t capacity() const { return capacity_; }
+
+    template<class T>
+    const T& safeCast() const { return mms::safeCast<T>(data(), size()); }
+
+    template<class T>
+    const T& unsafeCast() const { return mms::unsafeCast<T>(data(), size()); }
+
+private:
+    char* data_;
+    size_t capacity_;
+
+    BufferWriter(const BufferWriter&);
+    BufferWriter& operator = (const BufferWriter&);
+
+    void grow(size_t size)
+    {
+        reallocate(std::max(size, capacity_ * 2));
+    }
+
+    void reallocate(size_t size)
+    {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        void* p = 0;
+        if (posix_memalign(&p, ALIGNMENT, size) != 0)
+            throw std::bad_alloc();
+        if (data_)
+            memcpy(p, data_, pos());
+        free(data_);
+        data_ = static_cast<char*>(p);
+        capacity_ = size;
+    }
+};
+
+} // namespace mms
@@ -0,0 +1,297 @@
+/*
+ * mms/checksum.h -- CRC32C-checksummed output and its verification
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "cast.h"
+#include "impl/crc32c.h"
+
+#if MMS_USE_CXX11
+#    include "impl/parallel.h"
+#    include <thread>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace mms {
+
+/**
+ * Checksummed output is the output of safeWrite() (`data' below)
+ * followed by a table of CRC32C checksums of its consecutive blocks
+ * (the last one may be shorter) and by this trailer:
+ *
+ *   [ data | uint32_t crc[blockCount] | ChecksumTrailer ]
+ *
+ * The table is protected by its own checksum, so a corrupted block
+ * can be told from a corrupted table, and each block can be verified
+ * on its own whenever it is about to be used.
+ */
+struct ChecksumTrailer {
+    static const uint32_t MAGIC = 0x4d43524d; // = "MRCM"
+
+    uint64_t dataSize;
+    uint64_t blockSize;
+    uint32_t tableCrc;  ///< CRC32C of the table and of the two fields above
+    uint32_t magic;
+};
+
+/**
+ * A writer which computes CRC32C of everything passing through it
+ * and forwards it to another writer. finish() appends the table of
+ * checksums and the trailer.
+ *
+ * Positions continue from where `out' is, so alignment of the data
+ * holds within the whole output; checksummed data (and its blocks)
+ * start there.
+ *
+ *   mms::FdWriter out(fd);
+ *   mms::ChecksumWriter<mms::FdWriter> w(out);
+ *   mms::safeWrite(w, obj);
+ *   w.finish();
+ *   out.flush();
+ */
+template<class W>
+class ChecksumWriter: public impl::WriterBase {
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+    explicit ChecksumWriter(W& out, size_t blockSize = DEFAULT_BLOCK_SIZE):
+        impl::WriterBase(out.pos()),
+        out_(&out), start_(out.pos()), blockSize_(blockSize ? blockSize : 1),
+        crc_(0), blockUsed_(0)
+    {}
+
+    void write(const void* data, size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        for (size_t left = size; left; ) {
+            size_t n = std::min(left, blockSize_ - blockUsed_);
+            crc_ = impl::crc32c(crc_, p, n);
+            blockUsed_ += n;
+            p += n;
+            left -= n;
+            if (blockUsed_ == blockSize_)
+                nextBlock();
+        }
+        out_->write(data, size);
+        advance(size);
+    }
+
+    void reserve(size_t endPos) { out_->reserve(endPos + trailerSize(endPos - start_)); }
+
+    /// Writes the checksums. Nothing should be written afterwards.
+    void finish()
+    {
+        if (blockUsed_)
+            nextBlock();
+
+        ChecksumTrailer trailer;
+        trailer.dataSize = pos() - start_;
+        trailer.blockSize = blockSize_;
+        trailer.magic = ChecksumTrailer::MAGIC;
+        uint32_t crc = 0;
+        if (!crcs_.empty()) {
+            crc = impl::crc32c(crc, &crcs_[0], crcs_.size() * sizeof(uint32_t));
+            out_->write(&crcs_[0], crcs_.size() * sizeof(uint32_t));
+        }
+        trailer.tableCrc = impl::crc32c(crc, &trailer, offsetof(ChecksumTrailer, tableCrc));
+        out_->write(&trailer, sizeof(trailer));
+    }
+
+    size_t blockSize() const { return blockSize_; }
+
+private:
+    W* out_;
+    size_t start_;
+    size_t blockSize_;
+    uint32_t crc_;
+    size_t blockUsed_;
+    std::vector<uint32_t> crcs_;
+
+    void nextBlock()
+    {
+        crcs_.push_back(crc_);
+        crc_ = 0;
+        blockUsed_ = 0;
+    }
+
+    size_t trailerSize(size_t dataSize) const
+    {
+        return (dataSize + blockSize_ - 1) / blockSize_ * sizeof(uint32_t) + sizeof(ChecksumTrailer);
+    }
+};
+
+/**
+ * Reads the checksum table of a checksummed buffer and verifies
+ * the data against it, either all at once or block by block.
+ * The constructor throws std::runtime_error if the trailer
+ * or the table is damaged.
+ */
+class Checksums {
+public:
+    Checksums(const char* buffer, size_t size)
+    {
+        if (size < sizeof(ChecksumTrailer))
+            throw std::length_error("mms: buffer is too small to hold a checksum trailer");
+        ChecksumTrailer trailer;
+        memcpy(&trailer, buffer + size - sizeof(trailer), sizeof(trailer));
+        if (trailer.magic != ChecksumTrailer::MAGIC || !trailer.blockSize)
+            throw std::runtime_error("mms: no checksum trailer found");
+
+        blockSize_ = trailer.blockSize;
+        dataSize_ = trailer.dataSize;
+        blockCount_ = (dataSize_ + blockSize_ - 1) / blockSize_;
+        if (dataSize_ > size || blockCount_ > (size - dataSize_) / sizeof(uint32_t)
+            || dataSize_ + blockCount_ * sizeof(uint32_t) + sizeof(trailer) != size)
+        {
+            throw std::runtime_error("mms: checksum trailer does not match buffer size");
+        }
+
+        data_ = buffer;
+        table_ = buffer + dataSize_;
+        uint32_t crc = impl::crc32c(0, table_, blockCount_ * sizeof(uint32_t));
+        if (impl::crc32c(crc, &trailer, offsetof(ChecksumTrailer, tableCrc)) != trailer.tableCrc)
+            throw std::runtime_error("mms: checksum table is corrupted");
+    }
+
+    /// The checksummed data, i.e. what safeWrite() has produced.
+    const char* data() const { return data_; }
+    size_t dataSize() const { return dataSize_; }
+
+    size_t blockSize() const { return blockSize_; }
+    size_t blockCount() const { return blockCount_; }
+
+    bool checkBlock(size_t i) const
+    {
+        size_t start = i * blockSize_;
+        size_t size = std::min(blockSize_, dataSize_ - start);
+        uint32_t expected;
+        memcpy(&expected, table_ + i * sizeof(uint32_t), sizeof(expected));
+        return impl::crc32c(0, data_ + start, size) == expected;
+    }
+
+    /// Verifies all blocks overlapping with [offset, offset + size).
+    void verifyRange(size_t offset, size_t size) const
+    {
+        if (!size)
+            return;
+        if (offset > dataSize_ || size > dataSize_ - offset)
+            throw std::out_of_range("mms: range being verified is out of data");
+        for (size_t i = offset / blockSize_, ie = (offset + size - 1) / blockSize_; i <= ie; ++i)
+            verifyBlock(i);
+    }
+
+    /// Verifies everything, using up to `threads' threads
+    /// (0 stands for the number of CPUs; more than one requires C++11).
+    void verify(size_t threads = 0) const
+    {
+#if MMS_USE_CXX11
+        if (!threads)
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        if (threads > 1 && blockCount_ > 1) {
+            impl::parallelFor(blockCount_, threads, [this](size_t i) { verifyBlock(i); });
+            return;
+        }
+#else
+        (void) threads;
+#endif
+        for (size_t i = 0; i != blockCount_; ++i)
+            verifyBlock(i);
+    }
+
+    /// Verifies blocks holding the format version and the root object
+    /// and returns the latter. The rest can then be verified lazily.
+    template<class T>
+    const T& safeCast() const
+    {
+        size_t tail = std::min(dataSize_, sizeof(T) + sizeof(FormatVersion));
+        verifyRange(dataSize_ - tail, tail);
+        return mms::safeCast<T>(data_, dataSize_);
+    }
+
+private:
+    const char* data_;
+    const char* table_;
+    size_t dataSize_;
+    size_t blockSize_;
+    size_t blockCount_;
+
+    void verifyBlock(size_t i) const
+    {
+        if (!checkBlock(i)) {
+            std::ostringstream msg;
+            msg << "mms: checksum mismatch in block " << i
+                << " (bytes " << i * blockSize_ << "..."
+                << std::min(dataSize_, (i + 1) * blockSize_) << ")";
+            throw std::runtime_error(msg.str());
+        }
+    }
+};
+
+/// Same as safeWrite(), but followed by checksums (see ChecksumTrailer).
+/// Returned position is relative to where the writer was.
+template<class W, class T>
+typename impl::EnableIfWriter<W, size_t>::type checksummedWrite(W& w, const T& t)
+{
+    ChecksumWriter<W> cw(w);
+    cw.setThreads(w.threads(), w.chunkSize());
+    cw.setStringInterning(w.stringPool() != 0);
+    cw.setBodyAlignment(w.bodyThreshold(), w.bodyAlignment());
+    const size_t start = w.pos();
+    size_t pos = safeWrite(cw, t);
+    for (impl::Extents::const_iterator i = cw.bodyExtents().begin(), ie = cw.bodyExtents().end(); i != ie; ++i)
+        w.addBodyExtent(i->pos, i->size);
+    cw.finish();
+    return pos - start;
+}
+
+template<class T>
+size_t checksummedWrite(std::ostream& out, const T& t)
+{
+    Writer w(out);
+    return checksummedWrite(w, t);
+}
+
+/// Verifies checksums of the whole buffer (using up to `threads'
+/// threads, 0 for the number of CPUs) and does safeCast().
+template<class T>
+const T& checkedCast(const char* buffer, size_t size, size_t threads = 0)
+{
+    Checksums checksums(buffer, size);
+    checksums.verify(threads);
+    return mms::safeCast<T>(checksums.data(), checksums.dataSize());
+}
+
+} // namespace mms
@@ -0,0 +1,615 @@
+/*
+ * mms/compact.h -- rewriting mmapped data into a tight layout
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "mmap_file_writer.h"
+#include "mapped_file.h"
+#include "vector.h"
+#include "string.h"
+#include "map.h"
+#include "set.h"
+#include "optional.h"
+#include "unordered_map.h"
+#include "unordered_set.h"
+#include "buffer_writer.h"
+#include "impl/field_paths.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mms {
+
+/**
+ * Order in which compact() places bodies of containers.
+ *
+ * DepthFirst is the order mms writes data in: each container follows
+ * everything its elements refer to, so an element stays close
+ * to its payload.
+ *
+ * BreadthFirst groups bodies by their depth in the tree, deepest ones
+ * first: the root is followed by all of its children, which are
+ * preceded by all of theirs, and so on. Walking upper levels alone
+ * (indices, say) then touches a contiguous range of pages.
+ */
+enum CompactOrder { DepthFirst, BreadthFirst };
+
+/**
+ * Tells which parts of data are accessed often, naming them by paths
+ * of fields they are reached through, as ResidencyMap does: "records"
+ * is the body of a container, "records[].name" is every string
+ * in its elements, and so on. Marking a path hot makes its prefixes
+ * hot as well, since data cannot be reached without them; anything
+ * not marked is cold.
+ *
+ *   mms::AccessProfile profile;
+ *   profile.hot("byName").hot("byName[].first");
+ *   mms::compact(w, root, profile);
+ */
+class AccessProfile {
+public:
+    AccessProfile& hot(const std::string& path)
+    {
+        hot_.insert(path);
+        return *this;
+    }
+
+    /// Makes a profile out of ResidencyMap::rows(), treating a path
+    /// as hot if more than `minAccessedShare' of its pages were accessed
+    /// in samples taken.
+    template<class Rows>
+    static AccessProfile fromResidency(const Rows& rows, double minAccessedShare = 0)
+    {
+        AccessProfile profile;
+        for (typename Rows::const_iterator i = rows.begin(), ie = rows.end(); i != ie; ++i)
+            if (!i->path.empty() && i->path[0] != '(' && i->pages
+                && i->accessedPages > minAccessedShare * i->pages)
+            {
+                profile.hot(i->path);
+            }
+        return profile;
+    }
+
+    bool empty() const { return hot_.empty(); }
+    const std::set<std::string>& hotPaths() const { return hot_; }
+
+    /// Whether data at `path' (or anything reached through it) is hot.
+    bool isHot(const std::string& path) const
+    {
+        if (path.empty())
+            return true;
+        for (std::set<std::string>::const_iterator i = hot_.lower_bound(path);
+             i != hot_.end() && i->compare(0, path.size(), path) == 0; ++i)
+        {
+            if (i->size() == path.size() || (*i)[path.size()] == '.' || (*i)[path.size()] == '[')
+                return true;
+        }
+        return false;
+    }
+
+private:
+    std::set<std::string> hot_;
+};
+
+struct CompactStats {
+    size_t oldSize;
+    size_t newSize;
+
+    CompactStats(): oldSize(0), newSize(0) {}
+
+    size_t bytesReclaimed() const { return oldSize > newSize ? oldSize - newSize : 0; }
+
+    size_t pagesSaved(size_t pageSize = 4096) const
+    {
+        size_t oldPages = (oldSize + pageSize - 1) / pageSize;
+        size_t newPages = (newSize + pageSize - 1) / pageSize;
+        return oldPages > newPages ? oldPages - newPages : 0;
+    }
+};
+
+namespace impl {
+
+template<class Writer>
+class Compactor {
+public:
+    /// Path of fields nodes are reached through; only tracked
+    /// when there is a tree to put paths into.
+    class Path {
+    public:
+        Path(): tree_(0), id_(FieldPaths::ROOT) {}
+        explicit Path(FieldPaths& tree): tree_(&tree), id_(FieldPaths::ROOT) {}
+
+        Path field(const char* name, size_t index) const
+        {
+            return tree_ ? Path(tree_, tree_->field(id_, name, index)) : *this;
+        }
+
+        Path elements() const { return tree_ ? Path(tree_, tree_->elements(id_)) : *this; }
+
+        size_t id() const { return id_; }
+
+    private:
+        FieldPaths* tree_;
+        size_t id_;
+
+        Path(FieldPaths* tree, size_t id): tree_(tree), id_(id) {}
+    };
+
+    /// A container body (or a string, or an optional value) to be
+    /// written, along with a way to find out what it refers to
+    /// and to write it. Null nodes stand for missing optionals.
+    struct Node {
+        typedef void (*ChildrenFn)(const void*, std::vector<Node>&, Path);
+        typedef size_t (*WriteFn)(Writer&, const void*, OfsConsumeIter);
+
+        const void* obj;
+        ChildrenFn children;
+        WriteFn write;
+        Path path;
+
+        bool isNull() const { return !obj; }
+    };
+
+    typedef std::vector<Node> Nodes;
+
+    explicit Compactor(Writer& w): w_(&w), profile_(0) {}
+
+    template<class TMM>
+    size_t write(const TMM& root, CompactOrder order, bool writeVersion)
+    {
+        Nodes nodes;
+        addNodes(nodes, root);
+        Offsets positions;
+        if (order == DepthFirst)
+            writeDepthFirst(nodes, positions);
+        else
+            writeBreadthFirst(nodes, positions);
+
+        size_t cursor = 0;
+        return writeRoot(*w_, root, writeVersion, OfsConsumeIter(positions, cursor));
+    }
+
+    /// Writes all cold nodes (depth first) and then all hot ones,
+    /// so the latter end up next to the root. A node is never colder
+    /// than its children, hence offsets still point backwards.
+    template<class TMM>
+    size_t write(const TMM& root, const AccessProfile& profile, bool writeVersion)
+    {
+        FieldPaths paths;
+        profile_ = &profile;
+        paths_ = &paths;
+        hotness_.clear();
+
+        Nodes nodes;
+        addNodes(nodes, root, Path(paths));
+        Offsets coldRoots;
+        writeCold(nodes, coldRoots);
+        Offsets positions;
+        size_t coldCursor = 0;
+        writeHot(nodes, positions, coldRoots, coldCursor);
+
+        profile_ = 0;
+        paths_ = 0;
+        size_t cursor = 0;
+        return writeRoot(*w_, root, writeVersion, OfsConsumeIter(positions, cursor));
+    }
+
+    /// Appends nodes `t' consists of, in the order writeData() would
+    /// report their positions.
+    template<class TMM>
+    static void addNodes(Nodes& nodes, const TMM& t, Path path = Path());
+
+private:
+    Writer* w_;
+    const AccessProfile* profile_;
+    const FieldPaths* paths_;
+    std::vector<char> hotness_; // by path id: 0 if unknown, 1 if cold, 2 if hot
+
+    bool isHot(const Node& n)
+    {
+        size_t id = n.path.id();
+        if (hotness_.size() <= id)
+            hotness_.resize(paths_->size(), 0);
+        if (!hotness_[id])
+            hotness_[id] = profile_->isHot(paths_->str(id)) ? 2 : 1;
+        return hotness_[id] == 2;
+    }
+
+    // Writes cold subtrees hanging off hot nodes, remembering their positions
+    void writeCold(const Nodes& nodes, Offsets& coldRoots)
+    {
+        Nodes children;
+        for (typename Nodes::const_iterator i = nodes.begin(), ie = nodes.end(); i != ie; ++i) {
+            if (i->isNull())
+                continue;
+            if (isHot(*i)) {
+                children.clear();
+                i->children(i->obj, children, i->path);
+                writeCold(children, coldRoots);
+            } else {
+                writeDepthFirst(Nodes(1, *i), coldRoots);
+            }
+        }
+    }
+
+    // Writes hot nodes, taking positions of cold ones written by writeCold()
+    void writeHot(const Nodes& nodes, Offsets& positions, const Offsets& coldRoots, size_t& coldCursor)
+    {
+        Nodes children;
+        Offsets childPositions;
+        for (typename Nodes::const_iterator i = nodes.begin(), ie = nodes.end(); i != ie; ++i) {
+            if (!i->isNull() && !isHot(*i)) {
+                positions.push_back(coldRoots[coldCursor++]);
+                continue;
+            }
+            children.clear();
+            childPositions.clear();
+            if (!i->isNull()) {
+                i->children(i->obj, children, i->path);
+                writeHot(children, childPositions, coldRoots, coldCursor);
+            }
+            size_t cursor = 0;
+            positions.push_back(writeNode(*i, childPositions, cursor));
+        }
+    }
+
+    size_t writeNode(const Node& n, const Offsets& children, size_t& cursor)
+    {
+        return n.isNull() ? nullOfs() : n.write(*w_, n.obj, OfsConsumeIter(children, cursor));
+    }
+
+    void writeDepthFirst(const Nodes& nodes, Offsets& positions)
+    {
+        Nodes children;
+        Offsets childPositions;
+        for (typename Nodes::const_iterator i = nodes.begin(), ie = nodes.end(); i != ie; ++i) {
+            children.clear();
+            childPositions.clear();
+            if (!i->isNull()) {
+                i->children(i->obj, children, i->path);
+                writeDepthFirst(children, childPositions);
+            }
+            size_t cursor = 0;
+            positions.push_back(writeNode(*i, childPositions, cursor));
+        }
+    }
+
+    void writeBreadthFirst(const Nodes& top, Offsets& positions)
+    {
+        // levels[k][i] has its children at levels[k + 1][starts[k][i]...]
+        std::vector<Nodes> levels(1, top);
+        std::vector<Offsets> starts;
+        while (!levels.back().empty()) {
+            const Nodes& level = levels.back();
+            Nodes next;
+            starts.push_back(Offsets());
+            for (typename Nodes::const_iterator i = level.begin(), ie = level.end(); i != ie; ++i) {
+                starts.back().push_back(next.size());
+                if (!i->isNull())
+                    i->children(i->obj, next, i->path);
+            }
+            levels.push_back(Nodes());
+            levels.back().swap(next);
+        }
+
+        Offsets below;
+        for (size_t k = starts.size(); k-- > 0; ) {
+            Offsets current;
+            current.reserve(levels[k].size());
+            for (size_t i = 0; i != levels[k].size(); ++i) {
+                size_t cursor = starts[k][i];
+                current.push_back(writeNode(levels[k][i], below, cursor));
+            }
+            Nodes().swap(levels[k + 1]);
+            below.swap(current);
+        }
+        positions.swap(below);
+    }
+};
+
+// Tells how to find out children of a node of type TMM, and how
+// to write it (see specializations below)
+template<class Writer, class TMM>
+struct CompactNodeTraits;
+
+template<class Writer, class TMM, bool IsTrivial, bool HasWriters, bool HasTraverseFields>
+struct CompactNodesHelper;
+
+// Trivial types consist of no nodes
+template<class Writer, class TMM, bool HasWriters, bool HasTraverseFields>
+struct CompactNodesHelper<Writer, TMM, true, HasWriters, HasTraverseFields> {
+    typedef typename Compactor<Writer>::Path Path;
+    static void add(typename Compactor<Writer>::Nodes&, const TMM&, Path) {}
+};
+
+// Types having writers are nodes by themselves
+template<class Writer, class TMM, bool HasTraverseFields>
+struct CompactNodesHelper<Writer, TMM, false, true, HasTraverseFields> {
+    typedef typename Compactor<Writer>::Path Path;
+    static void add(typename Compactor<Writer>::Nodes& nodes, const TMM& t, Path path)
+    {
+        typedef CompactNodeTraits<Writer, TMM> Traits;
+        typename Compactor<Writer>::Node n = {
+            Traits::present(t) ? &t : 0, &Traits::children, &Traits::write, path
+        };
+        nodes.push_back(n);
+    }
+};
+
+// Structs consist of nodes of their fields
+template<class Writer, class TMM>
+struct CompactNodesHelper<Writer, TMM, false, false, true> {
+    typedef typename Compactor<Writer>::Path Path;
+
+    class AddNodes {
+    public:
+        typedef void AcceptsFieldNames;
+
+        AddNodes(typename Compactor<Writer>::Nodes& nodes, Path path):
+            nodes_(&nodes), path_(path), index_(0)
+        {}
+
+        template<class U>
+        void operator()(const U& u, const char* name)
+        {
+            size_t index = index_++;
+            if (!mms::type_traits::is_trivial<U>::value)
+                Compactor<Writer>::addNodes(*nodes_, u, path_.field(name, index));
+        }
+
+    private:
+        typename Compactor<Writer>::Nodes* nodes_;
+        Path path_;
+        size_t index_;
+    };
+
+    static void add(typename Compactor<Writer>::Nodes& nodes, const TMM& t, Path path)
+    {
+        traverseFields(t, ActionFacade<AddNodes>(AddNodes(nodes, path)));
+    }
+};
+
+template<class Writer>
+template<class TMM>
+inline void Compactor<Writer>::addNodes(Nodes& nodes, const TMM& t, Path path)
+{
+    CompactNodesHelper<
+        Writer, TMM,
+        mms::type_traits::is_trivial<TMM>::value,
+        sizeof(hasWriters<TMM>(0, 0)) == sizeof(Yes),
+        HasTraverseFields<TMM>::value
+    >::add(nodes, t, path);
+}
+
+// Bodies of sequences are written as writeRange() does
+template<class Writer, class C, class T>
+struct SequenceNodeTraits {
+    typedef typename Compactor<Writer>::Nodes Nodes;
+
+    static bool present(const C&) { return true; }
+
+    static void children(const void* obj, Nodes& nodes, typename Compactor<Writer>::Path path)
+    {
+        const C& c = *static_cast<const C*>(obj);
+        if (!mms::type_traits::is_trivial<T>::value)
+            for (const T* i = c.begin(), *ie = c.end(); i != ie; ++i)
+                Compactor<Writer>::addNodes(nodes, *i, path.elements());
+    }
+
+    static size_t write(Writer& w, const void* obj, OfsConsumeIter ofs)
+    {
+        const C& c = *static_cast<const C*>(obj);
+        align(w);
+        size_t pos = beginBody(w, c.size() * sizeof(T), alignmentOfMmapped<T>());
+        if (mms::type_traits::is_trivial<T>::value)
+            w.write(c.begin(), c.size() * sizeof(T));
+        else
+            for (const T* i = c.begin(), *ie = c.end(); i != ie; ++i)
+                writeField(w, *i, ofs);
+        endBody(w, pos);
+        return pos;
+    }
+};
+
+// Hashtables are sequences of items grouped by buckets,
+// followed by offsets of buckets (see Hashtable::writeData())
+template<class Writer, class C>
+struct HashtableNodeTraits {
+    typedef SequenceNodeTraits<Writer, C, typename C::value_type> Items;
+
+    static bool present(const C&) { return true; }
+
+    static void children(const void* obj, typename Compactor<Writer>::Nodes& nodes, typename Compactor<Writer>::Path path)
+    {
+        Items::children(obj, nodes, path);
+    }
+
+    static size_t write(Writer& w, const void* obj, OfsConsumeIter ofs)
+    {
+        const C& c = *static_cast<const C*>(obj);
+        if (!c.bucket_count())
+            return w.pos();
+        return c.writeBuckets(w, Items::write(w, obj, ofs));
+    }
+};
+
+template<class Writer, class T>
+struct CompactNodeTraits< Writer, vector<Mmapped, T> >:
+    SequenceNodeTraits<Writer, vector<Mmapped, T>, T> {};
+
+template<class Writer, class T, template<class> class Cmp>
+struct CompactNodeTraits< Writer, set<Mmapped, T, Cmp> >:
+    SequenceNodeTraits<Writer, set<Mmapped, T, Cmp>, T> {};
+
+template<class Writer, class K, class V, template<class> class Cmp>
+struct CompactNodeTraits< Writer, map<Mmapped, K, V, Cmp> >:
+    SequenceNodeTraits<Writer, map<Mmapped, K, V, Cmp>, std::pair<const K, V> > {};
+
+template<class Writer>
+struct CompactNodeTraits< Writer, string<Mmapped> > {
+    static bool present(const string<Mmapped>&) { return true; }
+    static void children(const void*, typename Compactor<Writer>::Nodes&, typename Compactor<Writer>::Path) {}
+
+    static size_t write(Writer& w, const void* obj, OfsConsumeIter)
+    {
+        const string<Mmapped>& s = *static_cast<const string<Mmapped>*>(obj);
+        return writeString(w, s.c_str(), s.size());
+    }
+};
+
+#ifdef MMS_FEATURES_OPTIONAL
+
+template<class Writer, class T>
+struct CompactNodeTraits< Writer, optional<Mmapped, T> > {
+    static bool present(const optional<Mmapped, T>& opt) { return opt.is_initialized(); }
+
+    static void children(const void* obj, typename Compactor<Writer>::Nodes& nodes, typename Compactor<Writer>::Path path)
+    {
+        Compactor<Writer>::addNodes(nodes, static_cast<const optional<Mmapped, T>*>(obj)->get(), path.elements());
+    }
+
+    static size_t write(Writer& w, const void* obj, OfsConsumeIter ofs)
+    {
+        return writeRoot(w, static_cast<const optional<Mmapped, T>*>(obj)->get(), false, ofs);
+    }
+};
+
+#endif // MMS_FEATURES_OPTIONAL
+
+#ifdef MMS_FEATURES_HASH
+
+template<class Writer, class K, class V, template<class> class Hash, template<class> class Eq>
+struct CompactNodeTraits< Writer, unordered_map<Mmapped, K, V, Hash, Eq> >:
+    HashtableNodeTraits< Writer, unordered_map<Mmapped, K, V, Hash, Eq> > {};
+
+template<class Writer, class T, template<class> class Hash, template<class> class Eq>
+struct CompactNodeTraits< Writer, unordered_set<Mmapped, T, Hash, Eq> >:
+    HashtableNodeTraits< Writer, unordered_set<Mmapped, T, Hash, Eq> > {};
+
+#endif // MMS_FEATURES_HASH
+
+} // namespace impl
+
+
+/**
+ * Writes mmapped `root' anew, element by element, so that none of
+ * what the original data used to have is carried over: regions no
+ * longer referred to, paddings left from former alignment settings,
+ * and (if `w' has interning on) duplicate strings. Bodies of containers
+ * are placed in `order'. Returns position of the root, as mms::write()
+ * does; the result is read as usual, with the same type.
+ *
+ * Unlike writing an Mmapped object with mms::write(), nothing is
+ * copied in bulk. Supported are trivial types, structs with
+ * traverseFields(), and vectors, sets, maps, strings, optionals
+ * and unordered maps and sets of them; anything else (ptr<> and
+ * shared_ptr<>, transients, types with writers of their own)
+ * fails to compile.
+ */
+template<class W, class TMM>
+inline typename impl::EnableIfWriter<W, size_t>::type
+compact(W& w, const TMM& root, CompactOrder order = DepthFirst)
+{
+    return impl::Compactor<W>(w).write(root, order, true);
+}
+
+/**
+ * Same as above, but bodies are placed by `profile': everything
+ * cold first, then everything hot, depth first within each group.
+ * As the root is written last, hot data ends up a contiguous range
+ * at the end of the output, adjacent to the root, and walking it
+ * does not bring pages of cold data in.
+ */
+template<class W, class TMM>
+inline typename impl::EnableIfWriter<W, size_t>::type
+compact(W& w, const TMM& root, const AccessProfile& profile)
+{
+    return impl::Compactor<W>(w).write(root, profile, true);
+}
+
+/// Writes Standalone `t' as safeWrite() would, with bodies placed by
+/// `profile' (see compact()). The data is serialized into memory
+/// first, so this takes twice the time of a regular write.
+template<class W, class T>
+inline typename impl::EnableIfWriter<W, size_t>::type
+safeWrite(W& w, const T& t, const AccessProfile& profile)
+{
+    BufferWriter buf;
+    safeWrite(buf, t);
+    return compact(w, buf.safeCast<typename MmappedType<T>::type>(), profile);
+}
+
+namespace impl {
+
+template<class TMM, class Layout>
+inline CompactStats compactFile(
+    const std::string& from, const std::string& to,
+    const Layout& layout, bool internStrings)
+{
+    MappedFile<TMM> in(from);
+
+    // The output is written to a temporary file, removed if anything
+    // fails, and renamed to `to' only when complete. The input is never
+    // written to, so `to' may be the same file as `from' (or a link to it):
+    // the mapping keeps the old contents until it is gone.
+    MmapFileWriter w(to);
+    w.setStringInterning(internStrings);
+    compact(w, *in, layout);
+    w.commit();
+
+    CompactStats stats;
+    stats.oldSize = in.size();
+    stats.newSize = w.pos();
+    return stats;
+}
+
+} // namespace impl
+
+/// Compacts data of type TMM written with safeWrite() to `from',
+/// writing the result to `to' (which may be `from' itself) atomically,
+/// as MmapFileWriter does.
+template<class TMM>
+inline CompactStats compactFile(
+    const std::string& from, const std::string& to,
+    CompactOrder order = DepthFirst, bool internStrings = false)
+{
+    return impl::compactFile<TMM>(from, to, order, internStrings);
+}
+
+/// Same as above, with bodies placed by `profile'.
+template<class TMM>
+inline CompactStats compactFile(
+    const std::string& from, const std::string& to,
+    const AccessProfile& profile, bool internStrings = false)
+{
+    return impl::compactFile<TMM>(from, to, profile, internStrings);
+}
+
+} // namespace mms
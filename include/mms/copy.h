@@ -32,6 +32,9 @@
 #include "cast.h"
 #include "impl/offsets.h"
 
+#include <cstring>
+#include <vector>
+
 namespace mms {
 
 /**
@@ -54,38 +57,94 @@ struct CopyHelper<TSA, false> {
     }
 };
 
+// Copy targets are often freshly constructed, with fields left
+// uninitialized. Passing one to traverseFields() by const reference
+// looks like a read to GCC (-Wmaybe-uninitialized), so the member
+// is called directly where there is one.
+template<bool HasMember>
+struct CopyTarget {
+    template<class T, class A>
+    static void traverse(T& t, A a) { t.traverseFields(a); }
+};
+
+template<>
+struct CopyTarget<false> {
+    template<class T, class A>
+    static void traverse(T& t, A a) { traverseFields(t, a); }
+};
+
 template<class TSA>
 struct CopyHelper<TSA, true> {
 
     class CopyAction {
     public:
-        explicit CopyAction(OfsConsumeIter ofs): ofs_(ofs) {}
+        CopyAction(const char* base, OfsConsumeIter ofs): base_(base), ofs_(ofs) {}
 
         template<class U>
         void operator()(const U& dest)
         {
             typedef typename impl::MmappedType<U>::type Mmapped;
-            const Mmapped* src = reinterpret_cast<const Mmapped*>(*ofs_);
+            const Mmapped* src = reinterpret_cast<const Mmapped*>(base_ + *ofs_);
             mms::copy(*src, const_cast<U&>(dest));
             ++ofs_;
         }
 
     private:
+        const char* base_;
         OfsConsumeIter ofs_;
     };
 
     static void copy(const typename impl::MmappedType<TSA>::type& from, TSA& to)
     {
-        Offsets ofs = offsets(from);
-        traverseFields(to, ActionFacade<CopyAction>(
-            CopyAction(OfsConsumeIter(ofs))
-        ));
+        typedef typename impl::MmappedType<TSA>::type TMM;
+        const Offsets& ofs = fieldOffsets<TMM>();
+        size_t cursor = 0;
+        CopyTarget<
+            sizeof(_hasTraverseFields<TSA>(0)) == sizeof(Yes)
+        >::traverse(to, ActionFacade<CopyAction>(CopyAction(
+            reinterpret_cast<const char*>(&from),
+            OfsConsumeIter(ofs, cursor)
+        )));
+    }
+};
+
+// Vectors of flat types (see hasFlatLayout()) are copied with memcpy().
+// Only instantiated for trivially copyable types, which are the only
+// ones hasFlatLayout() may say yes for.
+template<bool ToVector>
+struct FlatCopyHelper {
+    template<class Value, class From, class To>
+    static bool copy(const From&, To&) { return false; }
+};
+
+template<>
+struct FlatCopyHelper<true> {
+    template<class Value, class From, class To>
+    static bool copy(const From& from, To& to)
+    {
+        if (!hasFlatLayout<Value>())
+            return false;
+        to.resize(from.size());
+        if (!from.empty())
+            // Standalone and Mmapped types are distinct, but have
+            // the same layout (that's what hasFlatLayout() checks)
+            memcpy(static_cast<void*>(&to[0]), &*from.begin(), from.size() * sizeof(Value));
+        return true;
     }
 };
 
 template<class Value, class From, class To>
 inline To& copyRange(const From& from, To& to)
 {
+    if (FlatCopyHelper<
+            mms::type_traits::is_base_of<std::vector<Value>, To>::value
+            && !mms::type_traits::is_same<Value, bool>::value
+            && mms::type_traits::is_trivially_copyable<Value>::value
+        >::template copy<Value>(from, to))
+    {
+        return to;
+    }
+
     to.erase(to.begin(), to.end());
     for (typename From::const_iterator i = from.begin(), ie = from.end(); i != ie; ++i) {
         Value t;
@@ -0,0 +1,105 @@
+/*
+ * mms/fd_writer.h -- a buffered writer to a raw file descriptor
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "impl/posix.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+namespace mms {
+
+/**
+ * A writer which outputs directly to a file descriptor through
+ * a user-space buffer, bypassing std::ostream.
+ *
+ * Small chunks (offsets, sizes, paddings) are accumulated in the buffer;
+ * large ones (e.g. bodies of vectors of trivial types or long strings)
+ * are passed to writev() right from user memory along with whatever
+ * is buffered, thus avoiding an extra copy.
+ *
+ * The descriptor is not owned and is not closed. Call flush()
+ * before using the written data; the destructor flushes too,
+ * but has no way to report errors.
+ */
+class FdWriter: public impl::WriterBase {
+public:
+    static const size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    explicit FdWriter(int fd, size_t bufferSize = DEFAULT_BUFFER_SIZE):
+        fd_(fd), buf_(std::max<size_t>(bufferSize, 2 * sizeof(void*))), used_(0)
+    {}
+
+    ~FdWriter()
+    {
+        try {
+            flush();
+        }
+        catch (const std::exception&) {}
+    }
+
+    void write(const void* data, size_t size)
+    {
+        if (size <= buf_.size() - used_) {
+            memcpy(&buf_[used_], data, size);
+            used_ += size;
+        } else if (size < buf_.size() / 2) {
+            flush();
+            memcpy(&buf_[0], data, size);
+            used_ = size;
+        } else {
+            struct iovec iov[2] = {
+                { &buf_[0], used_ },
+                { const_cast<void*>(data), size }
+            };
+            impl::writeAll(fd_, iov, 2);
+            used_ = 0;
+        }
+        advance(size);
+    }
+
+    void flush()
+    {
+        if (used_) {
+            impl::writeAll(fd_, &buf_[0], used_);
+            used_ = 0;
+        }
+    }
+
+    int fd() const { return fd_; }
+
+private:
+    int fd_;
+    std::vector<char> buf_;
+    size_t used_;
+};
+
+} // namespace mms
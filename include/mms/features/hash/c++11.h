@@ -34,6 +34,7 @@
 #    define MMS_FEATURES_HASH CXX11
 #endif
 
+#include <cstddef>
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
@@ -43,7 +44,8 @@ namespace mms {
 namespace impl { template<size_t N> struct HashHelper {}; }
 
 template<class T>
-size_t hash_value(const T& t, impl::HashHelper<sizeof(std::hash<T>)>* = 0)
+size_t hash_value(const T& t,
+        impl::HashHelper<sizeof(std::hash<T>()(*static_cast<const T*>(0)))>* = 0)
     { return std::hash<T>()(t); }
 
 template<class T>
@@ -42,6 +42,9 @@ namespace mms {
 namespace type_traits {
 
 template<class T> struct is_trivial: public boost::is_pod<T> {};
+template<class T> struct is_trivially_copyable {
+    static const bool value = boost::has_trivial_copy<T>::value && boost::has_trivial_assign<T>::value;
+};
 template<class B, class D> struct is_base_of: public boost::is_base_of<B, D> {};
 template<class A, class B> struct is_same: public boost::is_same<A, B> {};
 template<class T> struct remove_cv: public boost::remove_cv<T> {};
@@ -40,6 +40,7 @@ namespace mms {
 namespace type_traits {
 
 template<class T> struct is_trivial: public std::is_trivial<T> {};
+template<class T> struct is_trivially_copyable: public std::is_trivially_copyable<T> {};
 template<class B, class D> struct is_base_of: public std::is_base_of<B, D> {};
 template<class A, class B> struct is_same: public std::is_same<A, B> {};
 template<class T> struct remove_cv: public std::remove_cv<T> {};
@@ -0,0 +1,134 @@
+/*
+ * impl/crc32c.h -- CRC32C (Castagnoli) checksum, SSE4.2-accelerated where available
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#    define MMS_CRC32C_SSE42 1
+#else
+#    define MMS_CRC32C_SSE42 0
+#endif
+
+namespace mms {
+namespace impl {
+
+// Lookup tables for slicing-by-8: table[k][b] is the CRC of byte b
+// followed by k zero bytes.
+class Crc32cTable {
+public:
+    static const uint32_t POLYNOMIAL = 0x82f63b78; // reversed 0x1edc6f41
+
+    Crc32cTable()
+    {
+        for (uint32_t b = 0; b != 256; ++b) {
+            uint32_t crc = b;
+            for (int i = 0; i != 8; ++i)
+                crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+            table[0][b] = crc;
+        }
+        for (int k = 1; k != 8; ++k)
+            for (uint32_t b = 0; b != 256; ++b)
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    }
+
+    uint32_t table[8][256];
+};
+
+inline const Crc32cTable& crc32cTable()
+{
+    static const Crc32cTable t;
+    return t;
+}
+
+/// Portable implementation; `crc' is the raw (non-inverted) register value.
+inline uint32_t crc32cSoftware(uint32_t crc, const char* p, size_t size)
+{
+    const uint32_t (&t)[8][256] = crc32cTable().table;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc; // NB: assumes little endian, as does the rest of mms
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+            ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff]
+            ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size; ++p, --size)
+        crc = (crc >> 8) ^ t[0][(crc ^ static_cast<unsigned char>(*p)) & 0xff];
+    return crc;
+}
+
+#if MMS_CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+inline uint32_t crc32cHardware(uint32_t crc, const char* p, size_t size)
+{
+    for (; size && (reinterpret_cast<uintptr_t>(p) & 7); ++p, --size)
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size; ++p, --size)
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    return crc;
+}
+
+inline bool hasHardwareCrc32c()
+{
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2") != 0);
+    return has;
+}
+
+#else
+
+inline bool hasHardwareCrc32c() { return false; }
+
+#endif
+
+/// Returns CRC32C of `size' bytes at `data', continuing
+/// a checksum `crc' of preceding bytes (0 for none).
+inline uint32_t crc32c(uint32_t crc, const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+#if MMS_CRC32C_SSE42
+    if (hasHardwareCrc32c())
+        return ~crc32cHardware(~crc, p, size);
+#endif
+    return ~crc32cSoftware(~crc, p, size);
+}
+
+}} // namespace mms::impl
@@ -30,9 +30,16 @@
 #pragma once
 
 #include "config.h"
-#include "front_remove_iterator.h"
-#include <deque>
+#include "pointee_map.h"
+#include "string_pool.h"
+#include <iterator>
+#include <stdexcept>
 #include <utility>
+#include <vector>
+
+#if MMS_USE_CXX11
+#    include <atomic>
+#endif
 
 namespace mms {
 
@@ -55,44 +62,209 @@ inline FieldDescriptor<T> makeFieldDescriptor(const char *name, T* object) {
 
 typedef std::pair<size_t, const void*> WriterID;
 
+// A region of output, relative to where the writer has started.
+struct Extent {
+    Extent(size_t pos, size_t size): pos(pos), size(size) {}
+
+    size_t pos;
+    size_t size;
+};
+
+typedef std::vector<Extent> Extents;
+
+typedef std::vector<size_t> Offsets;
+
+typedef std::back_insert_iterator<Offsets> OfsPopulateIter;
+
+// Reads offsets one by one. All copies share the same read position,
+// so nested writers pick up offsets where previous ones have stopped.
+class OfsConsumeIter {
+public:
+    OfsConsumeIter(const Offsets& ofs, size_t& cursor): ofs_(&ofs), cursor_(&cursor) {}
+
+    size_t operator*() const { return (*ofs_)[*cursor_]; }
+    OfsConsumeIter& operator++() { ++*cursor_; return *this; }
+
+private:
+    const Offsets* ofs_;
+    size_t* cursor_;
+
+    void operator++(int); // not defined
+};
+
 class WriterBase {
 public:
+    static const size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
     explicit WriterBase(size_t pos = 0, size_t transientPos = 0):
-        pos_(pos), transientPos_(transientPos), id_(nextId())
+        pos_(pos), transientPos_(transientPos), id_(nextId()),
+        threads_(1), chunkSize_(DEFAULT_CHUNK_SIZE), strings_(0),
+        bodyThreshold_(0), bodyAlignment_(0), maxAlignment_(sizeof(void*))
     {}
 
+    ~WriterBase() { delete strings_; }
+
     size_t pos() const { return pos_; }
 
     void putTransient(size_t size) { transientPos_ += size; }
     size_t transientPos() const { return transientPos_; }
 
-    // Returns a unique ID for writer.
-    // NB: using of both sequential number and address seems to eliminate
-    //     multithreading problems even without any atomics.
+    // Returns a unique ID for writer
     WriterID id() const { return WriterID(id_, this); }
 
+    // Pointees written so far (see PointeeMap)
+    PointeeMap& pointees() { return pointees_; }
+    const PointeeMap& pointees() const { return pointees_; }
+
+    // A hint that the output is going to end exactly at `endPos'
+    // (called after layout pass, if any). Writers which can make use
+    // of it (say, by preallocating memory) hide this function.
+    void reserve(size_t /*endPos*/) {}
+
+    // Lets containers of at least two chunks of elements be written
+    // with up to `threads' threads, a chunk per task. Output is the same
+    // as written by a single thread. Requires C++11; types needing
+    // a layout pass, as well as anything written with string interning
+    // on, are always written by a single thread.
+    void setThreads(size_t threads, size_t chunkSize = DEFAULT_CHUNK_SIZE)
+    {
+        threads_ = threads ? threads : 1;
+        chunkSize_ = chunkSize ? chunkSize : 1;
+    }
+
+    size_t threads() const { return threads_; }
+    size_t chunkSize() const { return chunkSize_; }
+
+    // A stack of offsets being passed from data pass to field pass
+    // (see OffsetsFrame). Kept between writes to avoid reallocations.
+    Offsets& offsetStack() { return offsetStack_; }
+
+    // Makes strings with equal contents be written only once: later
+    // copies refer to the first one, which is fine since mapped data
+    // is immutable. Costs a copy of each distinct string in memory;
+    // serializedSize() does not take interning into account.
+    void setStringInterning(bool enable)
+    {
+        if (enable && !strings_)
+            strings_ = new StringPool();
+        else if (!enable) {
+            delete strings_;
+            strings_ = 0;
+        }
+    }
+
+    // Null unless interning is on
+    StringPool* stringPool() { return strings_; }
+    const StringPool* stringPool() const { return strings_; }
+
+    // Makes bodies of containers (arrays of elements or of hashtable
+    // buckets) of at least `threshold' bytes start and end at a multiple
+    // of `alignment' (say, 4 KiB or 2 MiB), so that they share no pages
+    // with anything else and can be madvise()'d or mlock()'ed on their
+    // own. Extents of such bodies are recorded (see bodyExtents()).
+    // Zero threshold turns this off. Containers nested in ones written
+    // by several threads are not affected; neither is serializedSize().
+    void setBodyAlignment(size_t threshold, size_t alignment = 4096)
+    {
+        if (threshold && (alignment < sizeof(void*) || (alignment & (alignment - 1))))
+            throw std::invalid_argument("mms: body alignment must be a power of 2 not less than a pointer size");
+        bodyThreshold_ = threshold;
+        bodyAlignment_ = threshold ? alignment : 0;
+    }
+
+    size_t bodyThreshold() const { return bodyThreshold_; }
+    size_t bodyAlignment() const { return bodyAlignment_; }
+
+    // Extents of aligned container bodies, in order of writing.
+    const Extents& bodyExtents() const { return bodyExtents_; }
+    void addBodyExtent(size_t pos, size_t size) { bodyExtents_.push_back(Extent(pos, size)); }
+
+    // The largest alignment the output has been padded to so far.
+    size_t maxAlignment() const { return maxAlignment_; }
+    void noteAlignment(size_t alignment)
+    {
+        if (alignment > maxAlignment_)
+            maxAlignment_ = alignment;
+    }
+
 protected:
     void advance(size_t size) { pos_ += size; }
 
+    // Starts writing from scratch. The writer gets a new ID,
+    // and no pointee is considered to be already written.
+    void rewind()
+    {
+        pos_ = 0;
+        transientPos_ = 0;
+        id_ = nextId();
+        pointees_.clear();
+        if (strings_)
+            strings_->clear();
+        bodyExtents_.clear();
+        maxAlignment_ = sizeof(void*);
+    }
+
+    // For writers which merely look ahead of another one.
+    void setStringPool(StringPool* pool)
+    {
+        delete strings_;
+        strings_ = pool;
+    }
+
 private:
     size_t pos_;
     size_t transientPos_;
     size_t id_;
+    size_t threads_;
+    size_t chunkSize_;
+    Offsets offsetStack_;
+    StringPool* strings_;
+    size_t bodyThreshold_;
+    size_t bodyAlignment_;
+    Extents bodyExtents_;
+    size_t maxAlignment_;
+    PointeeMap pointees_;
 
     static size_t nextId()
     {
-        static size_t id = 0;
+#if MMS_USE_CXX11
+        static std::atomic<size_t> id(0);
         return ++id;
+#else
+        static volatile size_t id = 0;
+        return __sync_add_and_fetch(&id, 1);
+#endif
     }
 
     WriterBase(const WriterBase&) /* = delete */;
     WriterBase& operator = (const WriterBase&) /* = delete */;
 };
 
-typedef std::deque<size_t> Offsets;
+/**
+ * A frame on writer's offset stack. Offsets pushed during data pass
+ * of an object are read back during its field pass and are dropped
+ * when the frame is destroyed, so the stack only holds offsets
+ * of objects being written at the moment.
+ */
+class OffsetsFrame {
+public:
+    explicit OffsetsFrame(WriterBase& w):
+        ofs_(&w.offsetStack()), start_(ofs_->size()), cursor_(start_)
+    {}
+
+    ~OffsetsFrame() { ofs_->resize(start_); }
+
+    OfsPopulateIter populate() { return OfsPopulateIter(*ofs_); }
+    OfsConsumeIter consume() { return OfsConsumeIter(*ofs_, cursor_); }
 
-typedef std::back_insert_iterator <Offsets> OfsPopulateIter;
-typedef      front_remove_iterator<Offsets> OfsConsumeIter;
+private:
+    Offsets* ofs_;
+    size_t start_;
+    size_t cursor_;
+
+    OffsetsFrame(const OffsetsFrame&);
+    OffsetsFrame& operator = (const OffsetsFrame&);
+};
 
 
 template<class T>
@@ -0,0 +1,119 @@
+/*
+ * mms/impl/field_paths.h -- naming parts of mmapped data by fields they are reached through
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace mms {
+namespace impl {
+
+/**
+ * A tree of paths like "index", "index[]" (elements of a container),
+ * "index[].second" or "#2" (a field with no name, see mms::field()),
+ * each identified by a number; 0 stands for the root object.
+ */
+class FieldPaths {
+public:
+    static const size_t ROOT = 0;
+
+    FieldPaths(): nodes_(1, Node(ROOT, 0, 0, false)) {}
+
+    /// The path of a field of `parent', given either its name or its index.
+    size_t field(size_t parent, const char* name, size_t index) { return child(parent, name, index, false); }
+
+    /// The path of elements of a container at `parent'.
+    size_t elements(size_t parent) { return child(parent, 0, 0, true); }
+
+    size_t parent(size_t path) const { return nodes_[path].parent; }
+    size_t size() const { return nodes_.size(); }
+
+    /// Empty for the root
+    std::string str(size_t path) const
+    {
+        std::vector<size_t> chain;
+        for (; path != ROOT; path = nodes_[path].parent)
+            chain.push_back(path);
+
+        std::string result;
+        for (std::vector<size_t>::reverse_iterator i = chain.rbegin(); i != chain.rend(); ++i) {
+            const Node& n = nodes_[*i];
+            if (n.elements) {
+                result += "[]";
+                continue;
+            }
+            if (!result.empty())
+                result += ".";
+            if (n.name) {
+                result += n.name;
+            } else {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "#%zu", n.index);
+                result += buf;
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Node {
+        size_t parent;
+        const char* name;   // 0 for unnamed fields and elements
+        size_t index;       // of an unnamed field
+        bool elements;
+        std::vector<size_t> children;
+
+        Node(size_t p, const char* n, size_t i, bool e):
+            parent(p), name(n), index(i), elements(e)
+        {}
+    };
+
+    std::vector<Node> nodes_;
+
+    size_t child(size_t parent, const char* name, size_t index, bool elements)
+    {
+        const std::vector<size_t>& ch = nodes_[parent].children;
+        for (size_t i = 0; i != ch.size(); ++i) {
+            const Node& n = nodes_[ch[i]];
+            if (n.elements == elements && n.index == index
+                && (n.name == name || (n.name && name && !strcmp(n.name, name))))
+            {
+                return ch[i];
+            }
+        }
+        nodes_.push_back(Node(parent, name, index, elements));
+        nodes_[parent].children.push_back(nodes_.size() - 1);
+        return nodes_.size() - 1;
+    }
+};
+
+} // namespace impl
+} // namespace mms
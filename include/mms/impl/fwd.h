@@ -43,4 +43,6 @@ template<class P> class string;
 
 typedef size_t FormatVersion;
 
+namespace impl { class LayoutDeps; }
+
 }//namespace mms
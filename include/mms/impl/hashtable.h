@@ -30,6 +30,7 @@
 
 #include "defs.h"
 #include "container.h"
+#include "rewrite.h"
 #include "../writer.h"
 
 #include <functional>
@@ -116,18 +117,16 @@ public:
                 bucketSizes.begin(), --bucketSizes.end(), ++bucketPositions.begin());
 
         // Store pointers to items in grouped by buckets.
-        std::vector<const typename Container::value_type *> items(c.size(), 0);
+        typedef typename Container::value_type Item;
+        std::vector<const Item*> items(c.size(), 0);
 
         for (typename Container::const_iterator i = c.begin(), ie = c.end(); i != ie; ++i) {
             items[bucketPositions[hashVal(*i) % bucketCount]++] = &*i;
         }
 
-        Offsets ofs;
-
-        // Write data for items.
-        for (size_t i = 0, ie = items.size(); i != ie; ++i) {
-            impl::writeData(w, *items[i], OfsPopulateIter(ofs));
-        }
+        // Write data and fields for items.
+        size_t fieldsPos = writeItems<Item>(w,
+                DerefIterator<Item>(&items[0]), DerefIterator<Item>(&items[0] + items.size()));
 
         // Reset bucket positions and add a guard at the end.
         bucketPositions[0] = 0;
@@ -135,30 +134,20 @@ public:
                 bucketSizes.begin(), --bucketSizes.end(), ++bucketPositions.begin());
         bucketPositions.push_back(c.size());
 
-        // Write fields for items and store offsets at the beginnin of each bucket.
+        // Fields are all of the same size, so the offset
+        // of the beginning of each bucket is known.
+        const size_t fieldSize = sizeof(typename MmappedType<Item>::type);
         std::vector<size_t> bucketOffsets;
         bucketOffsets.reserve(bucketCount + 1);
-
-        align(w);
-
-        for (size_t i = 0, ie = items.size(), bucket = 0; i != ie; ++i) {
-            while (i == bucketPositions[bucket]) {
-                bucketOffsets.push_back(w.pos());
-                ++bucket;
-            }
-            impl::writeField(w, *items[i], OfsConsumeIter(ofs));
-        }
-        // Write offsets for empty buckets at the end.
-        while (bucketOffsets.size() != bucketCount + 1) {
-            bucketOffsets.push_back(w.pos());
-        }
-        align(w);
+        for (size_t bucket = 0; bucket != bucketCount + 1; ++bucket)
+            bucketOffsets.push_back(fieldsPos + bucketPositions[bucket] * fieldSize);
 
         // Write offsets of buckets
-        size_t pos = w.pos();
+        size_t pos = beginBody(w, bucketOffsets.size() * sizeof(size_t));
         for (size_t i = 0, ie = bucketOffsets.size(); i != ie; ++i) {
             writeOffset(w, bucketOffsets[i]);
         }
+        endBody(w, pos);
         return pos;
     }
 
@@ -168,6 +157,39 @@ public:
         return writeRef(w, dataPos, c.empty() ? 0 : c.bucket_count() + 1);
     }
 
+    // Mmapped hashtables are written by copying their items (see
+    // rewriteItems()), followed by offsets of buckets pointing into them.
+    template<class Writer>
+    size_t rewriteData(Writer& w) const
+    {
+        if (!bucket_count())
+            return w.pos();
+        return writeBuckets(w, rewriteItems(w, begin(), size()));
+    }
+
+    // Writes offsets of buckets for items of this hashtable
+    // written anew at `itemsPos'.
+    template<class Writer>
+    size_t writeBuckets(Writer& w, size_t itemsPos) const
+    {
+        const size_t fieldSize = sizeof(Value);
+        size_t pos = beginBody(w, buckets_.size() * sizeof(size_t));
+        for (size_t bucket = 0; bucket != bucket_count(); ++bucket)
+            writeOffset(w, itemsPos + (begin(bucket) - begin()) * fieldSize);
+        writeOffset(w, itemsPos + size() * fieldSize);
+        endBody(w, pos);
+        return pos;
+    }
+
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        if (bucket_count()) {
+            e.add(buckets_.begin(), buckets_.size() * sizeof(Offset), sizeof(Offset));
+            collectItems(e, begin(), size());
+        }
+    }
+
     size_t parasiteLoad() const {
         return sizeof(Offset)*(buckets_.end() - buckets_.begin());
     }
@@ -182,6 +204,19 @@ private:
     static size_t hashVal(const V& v) { return hashKey(SelectKey<V>()(v)); }
 
     static iterator nullIterator() { return static_cast<iterator>(0); }
+
+    // Iterates over an array of pointers to items, yielding items themselves.
+    template<class T>
+    class DerefIterator {
+    public:
+        explicit DerefIterator(const T* const* p): p_(p) {}
+        DerefIterator& operator ++ () { ++p_; return *this; }
+        const T& operator * () const { return **p_; }
+        bool operator == (const DerefIterator& i) const { return p_ == i.p_; }
+        bool operator != (const DerefIterator& i) const { return p_ != i.p_; }
+    private:
+        const T* const* p_;
+    };
 };
 
 } // namespace impl
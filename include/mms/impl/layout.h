@@ -0,0 +1,143 @@
+/*
+ * impl/layout.h -- finding out whether a type needs a layout pass
+ *                  before it can be written
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "../type_traits.h"
+#include <typeinfo>
+#include <set>
+
+namespace mms {
+namespace impl {
+
+template<class TMM, bool HasNeedsLayout, bool HasTraverseFields>
+struct LayoutDepsHelper;
+
+template<class T>
+Yes hasNeedsLayout(
+    Check<bool (*)(LayoutDeps&), &MmappedType<T>::type::needsLayout>*
+);
+template<class T>
+No hasNeedsLayout(...);
+
+/**
+ * Walks the type graph (in the very same way Versions does) to find out
+ * whether writing an object requires a preliminary pass through
+ * LayoutHelper, i.e. whether the object may contain transient<> regions
+ * or pointees which must have their positions known in advance.
+ *
+ * Mmapped classes may provide a 'static bool needsLayout(LayoutDeps&)'
+ * to tell it explicitly (usually via dependent<>()); classes having
+ * traverseFields() are examined field by field; trivial types never
+ * need a layout; anything else is conservatively assumed to need it.
+ */
+class LayoutDeps {
+public:
+    template<class T>
+    bool get()
+    {
+        typedef typename MmappedType<T>::type TMM;
+        std::pair<SeenSet::iterator, bool> pair = seen_.insert(&typeid(TMM));
+        if (!pair.second)
+            return false; // recursive types add nothing new
+        bool result = LayoutDepsHelper<
+            TMM,
+            sizeof(hasNeedsLayout<TMM>(0)) == sizeof(Yes),
+            HasTraverseFields<TMM>::value
+        >::needsLayout(*this);
+        seen_.erase(pair.first);
+        return result;
+    }
+
+    template<class T>
+    bool dependent() { return get<T>(); }
+
+    template<class T1, class T2>
+    bool dependent() { return get<T1>() || get<T2>(); }
+
+private:
+    typedef std::set<const std::type_info*> SeenSet;
+    SeenSet seen_;
+};
+
+// Case 1. Classes having a 'static bool needsLayout(LayoutDeps&)'.
+template<class TMM, bool HasTraverseFields>
+struct LayoutDepsHelper<TMM, true, HasTraverseFields> {
+    static bool needsLayout(LayoutDeps& deps) { return TMM::needsLayout(deps); }
+};
+
+// Case 2. Classes having traverseFields().
+//         Need a layout if any of their fields does.
+template<class TMM>
+struct LayoutDepsHelper<TMM, false, true> {
+    class FieldDeps {
+    public:
+        FieldDeps(LayoutDeps& deps, bool& result): deps_(&deps), result_(&result) {}
+
+        template<class U>
+        void operator()(const U&)
+        {
+            if (!*result_)
+                *result_ = deps_->get<U>();
+        }
+
+    private:
+        LayoutDeps* deps_;
+        bool* result_;
+    };
+
+    static bool needsLayout(LayoutDeps& deps)
+    {
+        const TMM* tmm = reinterpret_cast<const TMM*>(0);
+        bool result = false;
+        traverseFields(*tmm, ActionFacade<FieldDeps>(FieldDeps(deps, result)));
+        return result;
+    }
+};
+
+// Case 3. Anything else.
+//         Trivial types are written as they are; for the rest
+//         we have no idea what their writers do, so better be safe.
+template<class TMM>
+struct LayoutDepsHelper<TMM, false, false> {
+    static bool needsLayout(LayoutDeps&)
+    {
+        return !mms::type_traits::is_trivial<TMM>::value;
+    }
+};
+
+/// Returns true if writing T requires a layout pass.
+/// The type graph is only walked once per type.
+template<class T>
+inline bool needsLayout()
+{
+    static const bool result = LayoutDeps().get<T>();
+    return result;
+}
+
+} // namespace impl
+} // namespace mms
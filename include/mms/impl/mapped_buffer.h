@@ -0,0 +1,118 @@
+/*
+ * impl/mapped_buffer.h -- a growable shared mapping of a file, written to by mms writers
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "posix.h"
+
+#include <algorithm>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+namespace mms {
+namespace impl {
+
+/**
+ * A shared read-write mapping of a file, which writers storing data
+ * right into a file (MmapFileWriter, MemfdWriter) grow as writing
+ * goes on. The file descriptor belongs to the writer; `what' names
+ * the file in error messages.
+ */
+class MappedBuffer {
+public:
+    static const size_t ALIGNMENT = 4096;
+    static const size_t MAX_GROWTH = 1 << 30;
+
+    MappedBuffer(int fd, const std::string& what):
+        fd_(fd), what_(what), map_(0), capacity_(0)
+    {}
+
+    ~MappedBuffer() { unmap(); }
+
+    char* data() const { return map_; }
+    size_t capacity() const { return capacity_; }
+
+    /// Makes the file and the mapping at least `size' bytes long.
+    void reserve(size_t size)
+    {
+        if (size > capacity_)
+            remap(size);
+    }
+
+    /// Same as above, but at least doubles the size (up to MAX_GROWTH
+    /// at once), so that writing is not a series of tiny remaps.
+    void grow(size_t size)
+    {
+        if (size > capacity_)
+            remap(std::max(size, capacity_ + std::min(capacity_, size_t(MAX_GROWTH))));
+    }
+
+    void unmap()
+    {
+        if (map_) {
+            ::munmap(map_, capacity_);
+            map_ = 0;
+            capacity_ = 0;
+        }
+    }
+
+private:
+    int fd_;
+    std::string what_;
+    char* map_;
+    size_t capacity_;
+
+    MappedBuffer(const MappedBuffer&);
+    MappedBuffer& operator = (const MappedBuffer&);
+
+    void remap(size_t size)
+    {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        // Make sure blocks are actually there, so running out of disk
+        // space (or memory, or tmpfs limits) results in an exception
+        // rather than SIGBUS.
+        int err = posix_fallocate(fd_, 0, size);
+        if (err != 0) {
+            errno = err;
+            throwSystemError("mms: cannot allocate " + what_);
+        }
+        unmap();
+        void* p = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED)
+            throwSystemError("mms: cannot mmap " + what_);
+        map_ = static_cast<char*>(p);
+        capacity_ = size;
+    }
+};
+
+} // namespace impl
+} // namespace mms
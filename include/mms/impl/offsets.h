@@ -28,6 +28,10 @@
 #include "defs.h"
 #include "../type_traits.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace mms {
 namespace impl {
 
@@ -44,15 +48,113 @@ private:
     OfsPopulateIter ofs_;
 };
 
+template<class T>
+inline void storeOffsets(const T& t, OfsPopulateIter ofs)
+{
+    traverseFields(t, ActionFacade<StoreOffsets>(StoreOffsets(ofs)));
+}
+
 template<class T>
 inline Offsets offsets(const T& t)
 {
     Offsets ofs;
-    traverseFields(t, ActionFacade<StoreOffsets>(
-        StoreOffsets(OfsPopulateIter(ofs))
-    ));
+    storeOffsets(t, OfsPopulateIter(ofs));
+    return ofs;
+}
+
+/// Returns offsets of fields of T (in the order traverseFields()
+/// visits them) relative to the beginning of the object.
+/// They are the same for every object, so only computed once per type.
+template<class T>
+inline const Offsets& fieldOffsets()
+{
+    static const Offsets ofs = offsets(*reinterpret_cast<const T*>(0));
     return ofs;
 }
 
+
+template<class T> bool hasFlatLayout();
+
+// Collects positions and sizes of fields, checking they are all flat.
+class FlatLayoutProbe {
+public:
+    typedef std::vector< std::pair<size_t, size_t> > Fields;
+
+    FlatLayoutProbe(Fields& fields, bool& flat): fields_(&fields), flat_(&flat) {}
+
+    template<class U>
+    void operator()(const U& u)
+    {
+        if (!hasFlatLayout<U>() || sizeof(U) != sizeof(typename MmappedType<U>::type))
+            *flat_ = false;
+        fields_->push_back(std::make_pair(reinterpret_cast<size_t>(&u), sizeof(U)));
+    }
+
+private:
+    Fields* fields_;
+    bool* flat_;
+};
+
+// Follows the choice made by WriteHelper (see writer-impl.h).
+template<class T, bool IsTrivial, bool HasWriters, bool HasTraverseFields>
+struct FlatLayoutHelper {
+    static bool flat() { return false; }
+};
+
+// Trivial types are written as they are
+template<class T, bool HasWriters, bool HasTraverseFields>
+struct FlatLayoutHelper<T, true, HasWriters, HasTraverseFields> {
+    static bool flat() { return true; }
+};
+
+// Structs are written field by field, with zeroes in gaps between them
+template<class T>
+struct FlatLayoutHelper<T, false, false, true> {
+    static bool flat()
+    {
+        typedef typename MmappedType<T>::type TMM;
+        if (!mms::type_traits::is_trivially_copyable<T>::value
+            || sizeof(T) != sizeof(TMM)
+            || alignmentOfMmapped<T>() != alignmentOfMmapped<TMM>()
+            || fieldOffsets<T>() != fieldOffsets<TMM>())
+        {
+            return false;
+        }
+
+        FlatLayoutProbe::Fields fields;
+        bool flat = true;
+        traverseFields(*reinterpret_cast<const T*>(0),
+            ActionFacade<FlatLayoutProbe>(FlatLayoutProbe(fields, flat)));
+        if (!flat)
+            return false;
+
+        std::sort(fields.begin(), fields.end());
+        size_t end = 0;
+        for (FlatLayoutProbe::Fields::const_iterator i = fields.begin(), ie = fields.end(); i != ie; ++i) {
+            if (i->first != end)
+                return false;
+            end += i->second;
+        }
+        return end == sizeof(T);
+    }
+};
+
+/// Tells whether T is written byte for byte as it is in memory, i.e.
+/// it is trivial or is a struct of such fields, laid out exactly as
+/// its Mmapped counterpart and leaving no padding. Arrays of such
+/// types can be written and read back with a single memcpy().
+/// Found out once per type.
+template<class T>
+inline bool hasFlatLayout()
+{
+    static const bool flat = FlatLayoutHelper<
+        T,
+        mms::type_traits::is_trivial<T>::value,
+        sizeof(hasWriters<T>(0, 0)) == sizeof(Yes),
+        HasTraverseFields<T>::value
+    >::flat();
+    return flat;
+}
+
 } // namespace impl
 } // namespace mms
@@ -0,0 +1,91 @@
+/*
+ * impl/parallel.h -- running tasks on several threads
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "config.h"
+
+#if !MMS_USE_CXX11
+#    error "impl/parallel.h requires C++11"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mms {
+namespace impl {
+
+/// Calls f(0), ..., f(count - 1) on up to `threads' threads
+/// (the calling one included), in no particular order.
+/// If any call throws, remaining tasks are skipped and
+/// the first exception is rethrown once all threads are done.
+template<class F>
+void parallelFor(size_t count, size_t threads, F f)
+{
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorLock;
+
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < count; ) {
+            try {
+                f(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorLock);
+                if (!error)
+                    error = std::current_exception();
+                next = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    try {
+        for (size_t i = 1, ie = std::min(threads, count); i < ie; ++i)
+            pool.push_back(std::thread(worker));
+    }
+    catch (...) {
+        next = count;
+        for (size_t i = 0; i != pool.size(); ++i)
+            pool[i].join();
+        throw;
+    }
+
+    worker();
+    for (size_t i = 0; i != pool.size(); ++i)
+        pool[i].join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace impl
+} // namespace mms
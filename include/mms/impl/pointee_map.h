@@ -0,0 +1,125 @@
+/*
+ * impl/pointee_map.h -- positions of pointees, as known to a writer
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "config.h"
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+namespace mms {
+namespace impl {
+
+/**
+ * Keeps track of pointees (objects referred to with mms::ptr<>
+ * and similar classes) met by a writer: whether each of them
+ * has been written already, and where it is (or is going to be).
+ *
+ * Since it is the writer, not the pointee, that keeps the state,
+ * several writers may write objects sharing pointees concurrently.
+ *
+ * A map may have a read-only parent, which is searched as well;
+ * this is how layout pass learns about pointees written earlier.
+ */
+class PointeeMap {
+public:
+    explicit PointeeMap(const PointeeMap* parent = 0): parent_(parent) {}
+
+    void setParent(const PointeeMap* parent) { parent_ = parent; }
+
+    /// Tells whether `p' has been written (or is being written now,
+    /// which is the case for back references); if so, sets `pos'
+    /// to its position.
+    bool written(const void* p, size_t& pos) const
+    {
+        Entries::const_iterator i = entries_.find(p);
+        if (i != entries_.end() && i->second.written) {
+            pos = i->second.pos;
+            return true;
+        }
+        return parent_ && parent_->written(p, pos);
+    }
+
+    /// Called before `p' is written
+    void beganWriting(const void* p) { entries_[p].written = true; }
+
+    /// Called after `p' is written at `pos'; returns its position,
+    /// which is the one found out by layout pass, if any.
+    size_t endedWriting(const void* p, size_t pos)
+    {
+        if (pos & (sizeof(void*) - 1))
+            throw std::logic_error("object position is not a multiple of machine-word-size");
+        Entry& e = entries_[p];
+        if (!e.hasPos) {
+            e.pos = pos;
+            e.hasPos = true;
+        }
+        return e.pos;
+    }
+
+    /// Takes positions found out by layout pass, shifted by `diff'
+    /// (the size of transient region), as yet unwritten.
+    void addLaidOut(const PointeeMap& layout, size_t diff)
+    {
+        for (Entries::const_iterator i = layout.entries_.begin(), ie = layout.entries_.end(); i != ie; ++i) {
+            if (i->second.hasPos) {
+                Entry& e = entries_[i->first];
+                e.pos = i->second.pos + diff;
+                e.hasPos = true;
+                e.written = false;
+            }
+        }
+    }
+
+    void clear() { entries_.clear(); }
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        Entry(): pos(0), hasPos(false), written(false) {}
+
+        size_t pos;
+        bool hasPos;
+        bool written;
+    };
+
+#ifdef MMS_FEATURES_HASH
+    typedef unordered_map_base<const void*, Entry, mms::hash, std::equal_to>::type Entries;
+#else
+    typedef std::map<const void*, Entry> Entries;
+#endif
+
+    const PointeeMap* parent_;
+    Entries entries_;
+
+    PointeeMap(const PointeeMap&);
+    PointeeMap& operator = (const PointeeMap&);
+};
+
+}} // namespace mms::impl
@@ -0,0 +1,110 @@
+/*
+ * impl/posix.h -- thin wrappers around POSIX calls used by mms writers
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace mms {
+namespace impl {
+
+inline void throwSystemError(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + strerror(errno));
+}
+
+/// Writes all of `iov' to `fd', retrying on partial writes and EINTR.
+/// NB: modifies `iov' in place.
+inline void writeAll(int fd, struct iovec* iov, int count)
+{
+    while (count) {
+        ssize_t written = ::writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throwSystemError("mms: writev() failed");
+        }
+        for (; count && static_cast<size_t>(written) >= iov->iov_len; ++iov, --count)
+            written -= iov->iov_len;
+        if (count) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+inline void writeAll(int fd, const void* data, size_t size)
+{
+    struct iovec iov = { const_cast<void*>(data), size };
+    writeAll(fd, &iov, 1);
+}
+
+/// Writes `size' bytes to `fd' at `offset', retrying on partial writes and EINTR.
+inline void pwriteAll(int fd, const void* data, size_t size, off_t offset)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size) {
+        ssize_t written = ::pwrite(fd, p, size, offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throwSystemError("mms: pwrite() failed");
+        }
+        p += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+/// Flushes the directory containing `path', making a rename()
+/// or creation of `path' itself durable.
+inline void syncParentDir(const std::string& path)
+{
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "."
+        : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1)
+        throwSystemError("mms: cannot open " + dir);
+    if (::fsync(fd) != 0) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        throwSystemError("mms: cannot sync " + dir);
+    }
+    ::close(fd);
+}
+
+} // namespace impl
+} // namespace mms
@@ -0,0 +1,314 @@
+/*
+ * mms/impl/prefault.h -- bringing pages of mapped memory in, on several threads
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "config.h"
+#include "posix.h"
+
+#if MMS_USE_CXX11
+#    include "parallel.h"
+#    include <atomic>
+#    include <mutex>
+#    include <thread>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace mms {
+namespace impl {
+
+struct PageRange {
+    const char* begin;
+    const char* end;
+
+    PageRange(const char* b, const char* e): begin(b), end(e) {}
+    size_t size() const { return end - begin; }
+    bool operator < (const PageRange& r) const { return begin < r.begin; }
+};
+
+/// Adds pages holding [ptr, ptr + size) to `ranges', extending the last
+/// range if they adjoin it, as things referred to one after another
+/// mostly do (data is written depth first).
+inline void addPages(std::vector<PageRange>& ranges, const void* ptr, size_t size, size_t pageSize)
+{
+    if (!size)
+        return;
+    const size_t p = reinterpret_cast<size_t>(ptr);
+    const char* begin = reinterpret_cast<const char*>(p & ~(pageSize - 1));
+    const char* end = reinterpret_cast<const char*>((p + size + pageSize - 1) & ~(pageSize - 1));
+    if (!ranges.empty() && begin >= ranges.back().begin && begin <= ranges.back().end)
+        ranges.back().end = std::max(ranges.back().end, end);
+    else
+        ranges.push_back(PageRange(begin, end));
+}
+
+/// Sorts `ranges' and merges overlapping ones.
+inline void mergePages(std::vector<PageRange>& ranges)
+{
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<PageRange>::iterator out = ranges.begin();
+    for (std::vector<PageRange>::iterator i = ranges.begin(), ie = ranges.end(); i != ie; ++i) {
+        if (out != ranges.begin() && i->begin <= (out - 1)->end)
+            (out - 1)->end = std::max((out - 1)->end, i->end);
+        else
+            *out++ = *i;
+    }
+    ranges.erase(out, ranges.end());
+}
+
+struct PrefaultOptions {
+    /// Ask the kernel with madvise(MADV_WILLNEED) rather than touching pages
+    bool advise;
+
+    /// Number of threads (0 for the number of CPUs)
+    size_t threads;
+
+    /// Pages are prefaulted in chunks of this size
+    size_t chunkSize;
+
+    /// Bytes per second all threads together may bring in (0 for no limit)
+    size_t bandwidth;
+
+    /// Bind threads to NUMA nodes in turn, so pages are spread across them
+    bool numa;
+
+    PrefaultOptions(): advise(false), threads(1), chunkSize(1 << 20), bandwidth(0), numa(false) {}
+};
+
+inline double monotonicSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Paces work of several threads so that no more than `bandwidth'
+/// bytes a second are requested, on average.
+class Throttle {
+public:
+    explicit Throttle(size_t bandwidth):
+        bandwidth_(bandwidth), start_(monotonicSeconds()), issued_(0)
+    {}
+
+    /// Waits until `bytes' more can be processed.
+    void acquire(size_t bytes)
+    {
+        if (!bandwidth_)
+            return;
+#if MMS_USE_CXX11
+        size_t before = issued_.fetch_add(bytes);
+#else
+        size_t before = __sync_fetch_and_add(&issued_, bytes);
+#endif
+        double wait = start_ + double(before) / bandwidth_ - monotonicSeconds();
+        if (wait > 0) {
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(wait);
+            ts.tv_nsec = static_cast<long>((wait - ts.tv_sec) * 1e9);
+            while (::nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+        }
+    }
+
+private:
+    size_t bandwidth_;
+    double start_;
+#if MMS_USE_CXX11
+    std::atomic<size_t> issued_;
+#else
+    size_t issued_;
+#endif
+};
+
+/// Numbers listed in a sysfs file as ranges like "0-3,8-11";
+/// empty if there is no such file.
+inline std::vector<int> readSysfsList(const std::string& path)
+{
+    std::vector<int> result;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f)
+        return result;
+    int lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &hi) != 1)
+                break;
+            c = fgetc(f);
+        }
+        for (int i = lo; i <= hi; ++i)
+            result.push_back(i);
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+    return result;
+}
+
+/// CPUs of each online NUMA node, as listed in sysfs; empty if not known.
+/// Node numbers need not be contiguous (e.g. "0-1,3").
+inline std::vector<cpu_set_t> numaNodeCpus()
+{
+    std::vector<cpu_set_t> nodes;
+    const std::string root = "/sys/devices/system/node/";
+    std::vector<int> online = readSysfsList(root + "online");
+    for (size_t i = 0; i != online.size(); ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "node%d/cpulist", online[i]);
+        std::vector<int> list = readSysfsList(root + name);
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t j = 0; j != list.size(); ++j)
+            if (list[j] < CPU_SETSIZE)
+                CPU_SET(list[j], &cpus);
+        if (CPU_COUNT(&cpus))
+            nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+/// Binds the calling thread to `cpus' for its lifetime,
+/// restoring its former affinity afterwards.
+class AffinityGuard {
+public:
+    explicit AffinityGuard(const cpu_set_t* cpus): bound_(false)
+    {
+        if (cpus && ::sched_getaffinity(0, sizeof(saved_), &saved_) == 0)
+            bound_ = (::sched_setaffinity(0, sizeof(*cpus), cpus) == 0);
+    }
+
+    ~AffinityGuard()
+    {
+        if (bound_)
+            ::sched_setaffinity(0, sizeof(saved_), &saved_);
+    }
+
+private:
+    cpu_set_t saved_;
+    bool bound_;
+
+    AffinityGuard(const AffinityGuard&);
+    AffinityGuard& operator = (const AffinityGuard&);
+};
+
+inline void prefaultRange(const PageRange& r, bool advise, size_t pageSize)
+{
+    if (advise) {
+        if (::madvise(const_cast<char*>(r.begin), r.size(), MADV_WILLNEED) != 0)
+            throwSystemError("mms: madvise(MADV_WILLNEED) failed");
+    } else {
+        volatile char c;
+        for (const volatile char* p = r.begin; p < r.end; p += pageSize)
+            c = *p;
+        (void) c;
+    }
+}
+
+/// Splits page-aligned `ranges' into chunks of about `chunkSize' bytes.
+inline std::vector<PageRange> splitRanges(
+    const std::vector<PageRange>& ranges, size_t chunkSize, size_t pageSize)
+{
+    chunkSize = std::max((chunkSize + pageSize - 1) & ~(pageSize - 1), pageSize);
+    std::vector<PageRange> chunks;
+    for (size_t i = 0; i != ranges.size(); ++i)
+        for (const char* p = ranges[i].begin; p < ranges[i].end; p += chunkSize)
+            chunks.push_back(PageRange(p, std::min(p + chunkSize, ranges[i].end)));
+    return chunks;
+}
+
+/**
+ * Brings page-aligned `ranges' into memory, chunk by chunk, calling
+ * `progress(bytesDone, bytesTotal)' after each chunk (serially, though
+ * maybe on different threads). Returns the number of bytes.
+ */
+template<class Progress>
+size_t prefault(const std::vector<PageRange>& ranges, const PrefaultOptions& opts, Progress& progress)
+{
+    const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    const std::vector<PageRange> chunks = splitRanges(ranges, opts.chunkSize, pageSize);
+    size_t total = 0;
+    for (size_t i = 0; i != chunks.size(); ++i)
+        total += chunks[i].size();
+
+    Throttle throttle(opts.bandwidth);
+    std::vector<cpu_set_t> nodes;
+    if (opts.numa)
+        nodes = numaNodeCpus();
+
+#if MMS_USE_CXX11
+    size_t threads = opts.threads;
+    if (!threads)
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    threads = std::min(threads, chunks.size());
+    if (threads > 1 || !nodes.empty()) {
+        std::atomic<size_t> next(0);
+        std::mutex lock;
+        size_t done = 0;
+        // A task per thread, so that each one is bound only once
+        parallelFor(threads, threads, [&](size_t thread) {
+            AffinityGuard guard(nodes.empty() ? 0 : &nodes[thread % nodes.size()]);
+            for (size_t i; (i = next++) < chunks.size(); ) {
+                throttle.acquire(chunks[i].size());
+                prefaultRange(chunks[i], opts.advise, pageSize);
+                std::lock_guard<std::mutex> locked(lock);
+                done += chunks[i].size();
+                progress(done, total);
+            }
+        });
+        return total;
+    }
+#endif
+
+    AffinityGuard guard(nodes.empty() ? 0 : &nodes[0]);
+    size_t done = 0;
+    for (size_t i = 0; i != chunks.size(); ++i) {
+        throttle.acquire(chunks[i].size());
+        prefaultRange(chunks[i], opts.advise, pageSize);
+        done += chunks[i].size();
+        progress(done, total);
+    }
+    return total;
+}
+
+struct NoProgress {
+    void operator()(size_t /*bytesDone*/, size_t /*bytesTotal*/) const {}
+};
+
+} // namespace impl
+} // namespace mms
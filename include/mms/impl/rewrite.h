@@ -0,0 +1,222 @@
+/*
+ * impl/rewrite.h -- writing mmapped objects back, reusing their bytes
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "defs.h"
+#include "../type_traits.h"
+#include "../writer.h"
+
+#include <algorithm>
+
+namespace mms {
+namespace impl {
+
+/**
+ * Keeps track of memory an mmapped object refers to (bodies of its
+ * containers, along with everything their elements refer to).
+ *
+ * Offsets are relative, so if all of it lies within a region,
+ * the region can be copied elsewhere as a whole, and stays valid
+ * provided it keeps its alignment. Bytes in the region which are
+ * not referred to are copied as well, so regions noticeably larger
+ * than what is referred to are not worth copying.
+ */
+class PointeeExtent {
+public:
+    PointeeExtent(): lo_(0), hi_(0), bytes_(0), alignment_(sizeof(void*)), known_(true) {}
+
+    void add(const void* ptr, size_t size, size_t alignment)
+    {
+        if (!size)
+            return;
+        const char* p = static_cast<const char*>(ptr);
+        if (!lo_) {
+            lo_ = p;
+            hi_ = p + size;
+        } else {
+            lo_ = std::min(lo_, p);
+            hi_ = std::max(hi_, p + size);
+        }
+        bytes_ += (size + alignment - 1) & ~(alignment - 1);
+        alignment_ = std::max(alignment_, alignment);
+    }
+
+    // Called on objects which may refer to something we do not see
+    void unknown() { known_ = false; }
+
+    // Called around elements of a body being collected;
+    // collectors which do not go all the way down return false.
+    bool enter() { return true; }
+    void leave() {}
+
+    // Called around nontrivial fields of a structure, `name'
+    // being 0 unless given with mms::field()
+    void enterField(const char* /*name*/, size_t /*index*/) {}
+    void leaveField() {}
+
+    const char* begin() const { return lo_; }
+    size_t size() const { return hi_ - lo_; }
+    size_t alignment() const { return alignment_; }
+
+    bool worthCopying() const
+    {
+        return known_ && lo_
+            && !(reinterpret_cast<size_t>(lo_) & (alignment_ - 1))
+            && size() <= bytes_ + bytes_ / 2 + 4096;
+    }
+
+private:
+    const char* lo_;
+    const char* hi_;
+    size_t bytes_;
+    size_t alignment_;
+    bool known_;
+};
+
+// Collectors of pointees other than PointeeExtent (see prefetch.h) provide
+// the same add(), unknown(), enter(), leave(), enterField() and leaveField(),
+// so containers define
+//
+//   template<class Extent> void collectPointees(Extent&) const;
+//
+// which is detected by its PointeeExtent instance.
+template<class T>
+Yes hasCollectPointees(
+    Check<void (T::*)(PointeeExtent&) const, &T::collectPointees>*
+);
+template<class T>
+No hasCollectPointees(...);
+
+template<class TMM, bool IsTrivial, bool HasCollectPointees, bool HasTraverseFields>
+struct PointeesHelper;
+
+// Case 1. Trivial types refer to nothing.
+template<class TMM, bool HasCollectPointees, bool HasTraverseFields>
+struct PointeesHelper<TMM, true, HasCollectPointees, HasTraverseFields> {
+    template<class Extent>
+    static void collect(Extent&, const TMM&) {}
+};
+
+// Case 2. Classes having 'void collectPointees(Extent&) const'.
+template<class TMM, bool HasTraverseFields>
+struct PointeesHelper<TMM, false, true, HasTraverseFields> {
+    template<class Extent>
+    static void collect(Extent& e, const TMM& t) { t.collectPointees(e); }
+};
+
+// Case 3. Classes having traverseFields() refer to what their fields do.
+template<class TMM>
+struct PointeesHelper<TMM, false, false, true> {
+    template<class Extent>
+    class Collect {
+    public:
+        typedef void AcceptsFieldNames;
+
+        explicit Collect(Extent& e): e_(&e), index_(0) {}
+
+        template<class U>
+        void operator()(const U& u, const char* name)
+        {
+            size_t index = index_++;
+            if (mms::type_traits::is_trivial<U>::value)
+                return;
+            e_->enterField(name, index);
+            PointeesHelper<
+                U,
+                mms::type_traits::is_trivial<U>::value,
+                sizeof(hasCollectPointees<U>(0)) == sizeof(Yes),
+                HasTraverseFields<U>::value
+            >::collect(*e_, u);
+            e_->leaveField();
+        }
+
+    private:
+        Extent* e_;
+        size_t index_;
+    };
+
+    template<class Extent>
+    static void collect(Extent& e, const TMM& t)
+    {
+        traverseFields(t, ActionFacade< Collect<Extent> >(Collect<Extent>(e)));
+    }
+};
+
+// Case 4. Anything else.
+template<class TMM>
+struct PointeesHelper<TMM, false, false, false> {
+    template<class Extent>
+    static void collect(Extent& e, const TMM&) { e.unknown(); }
+};
+
+template<class Extent, class TMM>
+inline void collectPointees(Extent& e, const TMM& t)
+{
+    PointeesHelper<
+        TMM,
+        mms::type_traits::is_trivial<TMM>::value,
+        sizeof(hasCollectPointees<TMM>(0)) == sizeof(Yes),
+        HasTraverseFields<TMM>::value
+    >::collect(e, t);
+}
+
+/// Adds a body of `count' elements and everything they refer to.
+template<class Extent, class TMM>
+inline void collectItems(Extent& e, const TMM* begin, size_t count)
+{
+    e.add(begin, count * sizeof(TMM), alignmentOfMmapped<TMM>());
+    if (!mms::type_traits::is_trivial<TMM>::value && count && e.enter()) {
+        for (const TMM* i = begin, *ie = begin + count; i != ie; ++i)
+            collectPointees(e, *i);
+        e.leave();
+    }
+}
+
+/**
+ * Writes a body of `count' mmapped elements, along with everything
+ * they refer to; returns position of the body (cf. writeRange()).
+ * If all of that is found in a compact region, the region is copied
+ * in one go; otherwise elements are written one by one, each of them
+ * having a chance to be copied the same way.
+ */
+template<class TMM, class Writer>
+inline size_t rewriteItems(Writer& w, const TMM* begin, size_t count)
+{
+    PointeeExtent e;
+    collectItems(e, begin, count);
+    if (!e.worthCopying())
+        return writeRange<TMM>(w, begin, begin + count);
+
+    size_t start = beginBody(w, e.size(), e.alignment());
+    w.write(e.begin(), e.size());
+    endBody(w, start);
+    return start + (reinterpret_cast<const char*>(begin) - e.begin());
+}
+
+} // namespace impl
+} // namespace mms
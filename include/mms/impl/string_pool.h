@@ -0,0 +1,111 @@
+/*
+ * impl/string_pool.h -- positions of strings already written, for interning
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "config.h"
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace mms {
+namespace impl {
+
+/**
+ * Remembers where strings with given contents have been written,
+ * so that later copies can refer to the first one (see
+ * WriterBase::setStringInterning()). A pool may have a read-only
+ * parent, which is searched as well; this lets layout pass make
+ * the same decisions as the actual write that follows it.
+ */
+class StringPool {
+public:
+    explicit StringPool(const StringPool* parent = 0):
+        parent_(parent), hits_(0), savedBytes_(0)
+    {}
+
+    /// Looks for a string written earlier; counts a hit if found.
+    bool find(const char* str, size_t size, size_t& pos)
+    {
+        key_.assign(str, size);
+        if (!lookup(key_, pos))
+            return false;
+        ++hits_;
+        savedBytes_ += size + 1;
+        return true;
+    }
+
+    void add(const char* str, size_t size, size_t pos)
+    {
+        key_.assign(str, size);
+        positions_.insert(std::make_pair(key_, pos));
+    }
+
+    void clear()
+    {
+        positions_.clear();
+        hits_ = savedBytes_ = 0;
+    }
+
+    /// Number of distinct strings written
+    size_t size() const { return positions_.size(); }
+
+    /// Number of string copies not written, and bytes saved by that
+    /// (not counting alignment)
+    size_t hits() const { return hits_; }
+    size_t savedBytes() const { return savedBytes_; }
+
+private:
+#ifdef MMS_FEATURES_HASH
+    typedef unordered_map_base<std::string, size_t, mms::hash, std::equal_to>::type Positions;
+#else
+    typedef std::map<std::string, size_t> Positions;
+#endif
+
+    const StringPool* parent_;
+    Positions positions_;
+    std::string key_;
+    size_t hits_;
+    size_t savedBytes_;
+
+    bool lookup(const std::string& key, size_t& pos) const
+    {
+        Positions::const_iterator i = positions_.find(key);
+        if (i != positions_.end()) {
+            pos = i->second;
+            return true;
+        }
+        return parent_ && parent_->lookup(key, pos);
+    }
+
+    StringPool(const StringPool&);
+    StringPool& operator = (const StringPool&);
+};
+
+}} // namespace mms::impl
@@ -31,6 +31,7 @@
 #endif
 
 #include "offsets.h"
+#include "layout.h"
 #include "fwd.h"
 #include "../type_traits.h"
 #include "../version.h"
@@ -41,6 +42,11 @@
 
 #include <assert.h>
 
+#if MMS_USE_CXX11
+#    include "parallel.h"
+#    include <deque>
+#endif
+
 
 namespace mms {
 namespace impl {
@@ -69,7 +75,7 @@ inline size_t sanitizeAlignment(size_t alignment)
 {
     // alignment must be a power of 2
     assert((alignment & (alignment - 1)) == 0);
-    return std::min(alignment, sizeof(void*));
+    return std::min(alignment, MAX_ALIGNMENT);
 }
 
 inline bool isAligned(size_t pos, size_t size, size_t alignment = sizeof(void*))
@@ -83,7 +89,35 @@ inline bool isAligned(size_t pos, size_t size, size_t alignment = sizeof(void*))
 template<class Writer>
 inline void align(Writer& w, size_t alignment = sizeof(void*))
 {
-    addZeroes(w, (-w.pos()) & (sanitizeAlignment(alignment) - 1));
+    alignment = sanitizeAlignment(alignment);
+    w.noteAlignment(alignment);
+    addZeroes(w, (-w.pos()) & (alignment - 1));
+}
+
+// Container bodies are aligned to `alignment' (that of their elements),
+// or to more if the writer is asked to (see WriterBase::setBodyAlignment()).
+// beginBody() returns the position the body of `size' bytes starts at;
+// endBody() is called once it is written.
+template<class Writer>
+inline size_t beginBody(Writer& w, size_t size, size_t alignment = sizeof(void*))
+{
+    if (w.bodyThreshold() && size >= w.bodyThreshold() && w.bodyAlignment() >= alignment) {
+        w.noteAlignment(w.bodyAlignment());
+        addZeroes(w, (-w.pos()) & (w.bodyAlignment() - 1));
+    } else {
+        align(w, alignment);
+    }
+    return w.pos();
+}
+
+template<class Writer>
+inline void endBody(Writer& w, size_t start)
+{
+    size_t size = w.pos() - start;
+    if (w.bodyThreshold() && size >= w.bodyThreshold()) {
+        w.addBodyExtent(start, size);
+        addZeroes(w, (-w.pos()) & (w.bodyAlignment() - 1));
+    }
 }
 
 template<class Writer>
@@ -103,6 +137,12 @@ inline size_t writeOffset(Writer& w, size_t dataPos)
     return offsetPos;
 }
 
+// Field records spooled by VectorBuilder do not know their final
+// position yet, so offsets are stored there as absolute positions
+// (see vector_builder.h).
+class FieldSpooler;
+inline size_t writeOffset(FieldSpooler& w, size_t dataPos);
+
 template<class Writer>
 inline size_t writeRef(Writer& w, size_t dataPos, size_t size)
 {
@@ -119,81 +159,311 @@ void writeData(Writer& w, const TSA& t, OfsPopulateIter ofs);
 template<class Writer, class TSA>
 void writeField(Writer& w, const TSA& t, OfsConsumeIter ofs);
 
+// Writes the top-level object itself, once everything
+// it refers to is written; returns its position.
 template<class Writer, class T>
-inline size_t write(Writer& w, const T& t, bool writeFormatVersion)
+inline size_t writeRoot(Writer& w, const T& t, bool writeFormatVersion, OfsConsumeIter ofs)
 {
-    Offsets ofs;
-    writeData(w, t, impl::OfsPopulateIter(ofs));
     align(w);
+    const size_t alignment = alignmentOf<T>();
     if (writeFormatVersion) {
+        // The version immediately precedes the object (see safeCast()),
+        // so it is the object that gets aligned, not the version.
+        w.noteAlignment(alignment);
+        addZeroes(w, (-(w.pos() + sizeof(FormatVersion))) & (alignment - 1));
         writePod(w, Versions().get<T>());
-        align(w);
+    } else {
+        align(w, alignment);
     }
     size_t fieldPos = w.pos();
-    writeField(w, t, impl::OfsConsumeIter(ofs));
+    writeField(w, t, ofs);
     return fieldPos;
 }
 
+template<class Writer, class T>
+inline size_t write(Writer& w, const T& t, bool writeFormatVersion)
+{
+    OffsetsFrame ofs(w);
+    writeData(w, t, ofs.populate());
+    return writeRoot(w, t, writeFormatVersion, ofs.consume());
+}
+
 template<class Writer, class T>
 inline size_t write(Writer& w, const T& t) { return write(w, t, false); }
 
+#if MMS_USE_CXX11
+
+// Counts the size of a chunk of data which is going to be written
+// at a yet unknown position. Only the first padding depends on where
+// the chunk starts (all the following are relative to an aligned
+// position), so it is enough to remember where it occurs.
+// NB: this relies on everything being aligned to sizeof(void*)
+//     (see maxAlignment()).
+class RangeSizer: public WriterBase {
+public:
+    RangeSizer(): firstAlign_(NoAlign) {}
+
+    void write(const void*, size_t size) { advance(size); }
+
+    void aligning()
+    {
+        if (firstAlign_ == NoAlign)
+            firstAlign_ = pos();
+    }
+
+    /// Returns size of the chunk if written starting at `start'.
+    size_t sizeAt(size_t start) const
+    {
+        if (firstAlign_ == NoAlign)
+            return pos();
+        return pos() - padding(firstAlign_) + padding(start + firstAlign_);
+    }
+
+private:
+    static const size_t NoAlign = size_t(-1);
+    size_t firstAlign_;
+
+    static size_t padding(size_t pos) { return (-pos) & (sizeof(void*) - 1); }
+};
+
+inline void align(RangeSizer& w, size_t alignment = sizeof(void*))
+{
+    alignment = sanitizeAlignment(alignment);
+    w.aligning();
+    w.noteAlignment(alignment);
+    addZeroes(w, (-w.pos()) & (alignment - 1));
+}
+
+// Writes a chunk of output, starting at a known position, into memory.
+class ChunkWriter: public WriterBase {
+public:
+    ChunkWriter(size_t pos, size_t size): WriterBase(pos, 0) { buf_.reserve(size); }
+
+    void write(const void* data, size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        buf_.insert(buf_.end(), p, p + size);
+        advance(size);
+    }
+
+    template<class Writer>
+    void flushTo(Writer& w, size_t expectedSize)
+    {
+        if (buf_.size() != expectedSize)
+            throw std::logic_error("mms: parallel write produced unexpected amount of data");
+        if (!buf_.empty())
+            w.write(&buf_[0], buf_.size());
+        std::vector<char>().swap(buf_);
+    }
+
+private:
+    std::vector<char> buf_;
+};
+
+template<class Iter>
+inline bool hasAtLeast(Iter begin, Iter end, size_t count)
+{
+    for (; count && begin != end; ++begin)
+        --count;
+    return !count;
+}
+
+// Parallel version of writeItems() (see below).
+// Elements are split into chunks; each batch of chunks is written
+// in two parallel passes: the first one finds out sizes of chunks
+// (and thus the exact positions they will be written at), the second
+// one writes them into memory, which is then appended to `w' in order.
+// Fields (all of the same size) are written the same way.
+template<class T, class Writer, class Iter>
+size_t parallelWriteItems(Writer& w, Iter begin, Iter end)
+{
+    const size_t threads = w.threads();
+    const size_t chunkSize = w.chunkSize();
+    const size_t batchSize = threads * 4;
+    const size_t fieldSize = sizeof(typename MmappedType<T>::type);
+
+    std::vector<Iter> bounds;
+    size_t count = 0;
+    for (Iter i = begin; i != end; ++i, ++count)
+        if (count % chunkSize == 0)
+            bounds.push_back(i);
+    bounds.push_back(end);
+    const size_t chunks = bounds.size() - 1;
+
+    std::vector<Offsets> ofs(chunks);
+    std::vector<size_t> cursors(chunks, 0);
+
+    for (size_t first = 0; first < chunks; first += batchSize) {
+        const size_t n = std::min(batchSize, chunks - first);
+
+        std::deque<RangeSizer> sizers(n);
+        parallelFor(n, threads, [&](size_t k) {
+            OffsetsFrame dummy(sizers[k]);
+            for (Iter i = bounds[first + k], ie = bounds[first + k + 1]; i != ie; ++i)
+                impl::writeData(sizers[k], static_cast<const T&>(*i), dummy.populate());
+        });
+
+        bool overAligned = false;
+        for (size_t k = 0; k != n; ++k)
+            overAligned |= sizers[k].maxAlignment() > sizeof(void*);
+        if (overAligned) {
+            // Paddings depend on more than the first one, so sizes
+            // are not known in advance; write the batch right away.
+            for (size_t k = 0; k != n; ++k)
+                for (Iter i = bounds[first + k], ie = bounds[first + k + 1]; i != ie; ++i)
+                    impl::writeData(w, static_cast<const T&>(*i), OfsPopulateIter(ofs[first + k]));
+            continue;
+        }
+
+        std::vector<size_t> sizes(n);
+        std::deque<ChunkWriter> writers;
+        for (size_t k = 0, pos = w.pos(); k != n; pos += sizes[k++]) {
+            sizes[k] = sizers[k].sizeAt(pos);
+            writers.emplace_back(pos, sizes[k]);
+        }
+
+        parallelFor(n, threads, [&](size_t k) {
+            for (Iter i = bounds[first + k], ie = bounds[first + k + 1]; i != ie; ++i)
+                impl::writeData(writers[k], static_cast<const T&>(*i), OfsPopulateIter(ofs[first + k]));
+        });
+        for (size_t k = 0; k != n; ++k)
+            writers[k].flushTo(w, sizes[k]);
+    }
+
+    const size_t fieldsPos = beginBody(w, count * fieldSize, alignmentOf<T>());
+
+    for (size_t first = 0; first < chunks; first += batchSize) {
+        const size_t n = std::min(batchSize, chunks - first);
+
+        std::vector<size_t> sizes(n);
+        std::deque<ChunkWriter> writers;
+        for (size_t k = 0; k != n; ++k) {
+            size_t index = (first + k) * chunkSize;
+            sizes[k] = (std::min(count, index + chunkSize) - index) * fieldSize;
+            writers.emplace_back(fieldsPos + index * fieldSize, sizes[k]);
+        }
+
+        parallelFor(n, threads, [&](size_t k) {
+            for (Iter i = bounds[first + k], ie = bounds[first + k + 1]; i != ie; ++i)
+                impl::writeField(writers[k], static_cast<const T&>(*i),
+                    OfsConsumeIter(ofs[first + k], cursors[first + k]));
+            Offsets().swap(ofs[first + k]);
+        });
+        for (size_t k = 0; k != n; ++k)
+            writers[k].flushTo(w, sizes[k]);
+    }
+    endBody(w, fieldsPos);
+
+    return fieldsPos;
+}
+
+#endif // MMS_USE_CXX11
+
+// Writes data of all elements, followed by their fields;
+// returns position of the first field.
 // Needs to know the type the iterator is supposed to dereference to.
 // For example std::vector<bool>::iterator does not dereference to bool.
 template<class T, class Writer, class Iter>
-inline size_t writeRange(Writer& w, Iter begin, Iter end)
+inline size_t writeItems(Writer& w, Iter begin, Iter end)
 {
-    align(w);
-    impl::Offsets ofs;
-    for (Iter i = begin; i != end; ++i) {
+#if MMS_USE_CXX11
+    if (w.threads() > 1 && !needsLayout<T>() && !w.stringPool()
+        && hasAtLeast(begin, end, 2 * w.chunkSize()))
+        return parallelWriteItems<T>(w, begin, end);
+#endif
+
+    OffsetsFrame ofs(w);
+    size_t count = 0;
+    for (Iter i = begin; i != end; ++i, ++count) {
         // Cast itertator dereference to correct type.
-        impl::writeData(w, static_cast<const T&>(*i), impl::OfsPopulateIter(ofs));
+        impl::writeData(w, static_cast<const T&>(*i), ofs.populate());
     }
-    align(w);
-    size_t fieldsPos = w.pos();
+    size_t fieldsPos = beginBody(w, count * sizeof(typename MmappedType<T>::type), alignmentOf<T>());
     for (Iter i = begin; i != end; ++i) {
         // Cast itertator dereference to correct type.
-        impl::writeField(w, static_cast<const T&>(*i), impl::OfsConsumeIter(ofs));
+        impl::writeField(w, static_cast<const T&>(*i), ofs.consume());
     }
+    endBody(w, fieldsPos);
     return fieldsPos;
 }
 
+template<class T, class Writer, class Iter>
+inline size_t writeRange(Writer& w, Iter begin, Iter end)
+{
+    align(w);
+    return writeItems<T>(w, begin, end);
+}
+
 
 class LayoutHelper: public WriterBase {
 public:
-    explicit LayoutHelper(const Writer& w): WriterBase(w.pos(), 0), writer_(&w) {}
-    void write(const void*, size_t size) { advance(size); }
-    const Writer* writer() const { return writer_; }
-    
-    void addPointee(size_t& pos) { pointees_.push_back(&pos); }
-    
-    void adjustPointees(ssize_t diff)
+    explicit LayoutHelper(const WriterBase& w): WriterBase(w.pos(), 0), writer_(&w)
     {
-        for (std::vector<size_t*>::iterator i = pointees_.begin(), ie = pointees_.end(); i != ie; ++i)
-            **i += diff;
+        // Strings must be interned and bodies aligned exactly as
+        // the actual write will do
+        if (w.stringPool())
+            setStringPool(new StringPool(w.stringPool()));
+        setBodyAlignment(w.bodyThreshold(), w.bodyAlignment());
+        // Pointees written before are not to be written again
+        pointees().setParent(&w.pointees());
     }
+    void write(const void*, size_t size) { advance(size); }
+    const WriterBase* writer() const { return writer_; }
 
 private:
-    const Writer* writer_;
-    std::vector<size_t*> pointees_;
+    const WriterBase* writer_;
+};
+
+// Counts bytes instead of writing them.
+// Pointees met on the way are only recorded by the counter itself,
+// so counting does not interfere with actual writes.
+class SizeCounter: public WriterBase {
+public:
+    explicit SizeCounter(size_t pos = 0): WriterBase(pos, 0) {}
+
+    void write(const void*, size_t size) { advance(size); }
 };
 
+// The transient region is padded so that all paddings in the data
+// following it stay the same as they were when it was being laid out.
+inline size_t transientRegionSize(const WriterBase& w)
+{
+    return (w.transientPos() + w.maxAlignment() - 1) & ~(w.maxAlignment() - 1);
+}
+
+template<class T>
+inline size_t serializedSize(const T& t, bool writeVersion)
+{
+    SizeCounter c;
+    impl::write(c, t, writeVersion);
+    // Actual data will follow the transient region (see layOut() below).
+    return transientRegionSize(c) + c.pos();
+}
+
+// Runs the whole write through LayoutHelper to find out the size
+// of transient region and positions of all pointees.
+// Only needed if needsLayout<T>() says so; otherwise the region
+// is empty and there is nothing to fix up.
 template<class Writer, class T>
 inline void layOut(Writer& w, const T& t, bool writeVersion)
 {
     LayoutHelper h(w);
     impl::write(h, t, writeVersion);
     align(h);
-    impl::addZeroes(w, h.transientPos());
-    h.adjustPointees(h.transientPos());
+    const size_t transientSize = transientRegionSize(h);
+    w.reserve(h.pos() + transientSize);
+    impl::addZeroes(w, transientSize);
+    w.pointees().addLaidOut(h.pointees(), transientSize);
 }
 
 } //namespace impl
 
 
-template<class T>
-inline size_t safeWrite(Writer& w, const T& t)
+template<class W, class T>
+inline typename impl::EnableIfWriter<W, size_t>::type safeWrite(W& w, const T& t)
 {
-    impl::layOut(w, t, true);
+    if (impl::needsLayout<T>())
+        impl::layOut(w, t, true);
     return impl::write(w, t, true);
 }
 
@@ -201,14 +471,14 @@ template<class T>
 inline size_t safeWrite(std::ostream& out, const T& t)
 {
     Writer w(out);
-    impl::layOut(w, t, true);
-    return impl::write(w, t, true);
+    return safeWrite(w, t);
 }
 
-template<class T>
-inline size_t unsafeWrite(Writer& w, const T& t)
+template<class W, class T>
+inline typename impl::EnableIfWriter<W, size_t>::type unsafeWrite(W& w, const T& t)
 {
-    impl::layOut(w, t, false);
+    if (impl::needsLayout<T>())
+        impl::layOut(w, t, false);
     return impl::write(w, t, false);
 }
 
@@ -216,10 +486,15 @@ template<class T>
 inline size_t unsafeWrite(std::ostream& out, const T& t)
 {
     Writer w(out);
-    impl::layOut(w, t, false);
-    return impl::write(w, t, false);
+    return unsafeWrite(w, t);
 }
 
+template<class T>
+inline size_t safeSerializedSize(const T& t) { return impl::serializedSize(t, true); }
+
+template<class T>
+inline size_t unsafeSerializedSize(const T& t) { return impl::serializedSize(t, false); }
+
 namespace impl {
 
 template<class Writer, class TSA, bool IsTrivial, bool HasMethods>
@@ -281,11 +556,10 @@ struct WriteHelper<Writer, TSA, false, false> {
     static void writeField(Writer& w, const TSA& t, OfsConsumeIter dataOfs)
     {
         typedef typename MmappedType<TSA>::type TMM;
-        const TMM* tmm = reinterpret_cast<const TMM*>(0);
-        Offsets fieldOfs = offsets(*tmm);
+        size_t cursor = 0;
         size_t startPos = w.pos();
         traverseFields(t, ActionFacade<WriteField>(
-            WriteField(w, dataOfs, OfsConsumeIter(fieldOfs))));
+            WriteField(w, dataOfs, OfsConsumeIter(fieldOffsets<TMM>(), cursor))));
         addZeroes(w, startPos +
                 sizeof(typename MmappedType<TSA>::type) - w.pos());
     }
@@ -318,7 +592,23 @@ struct WriteHelper<Writer, TSA, false, true> {
     }
 };
 
+// Case 4: types having their writers defined outside
+//         (see ExternalWriters in type_traits.h).
+//         Same as above.
 template<class Writer, class TSA>
+struct ExternalWriteHelper {
+    static void writeData (Writer& w, const TSA& t, OfsPopulateIter ofs)
+    {
+        *ofs++ = ExternalWriters<TSA>::writeData(w, t);
+    }
+    static void writeField(Writer& w, const TSA& t, OfsConsumeIter ofs)
+    {
+        ExternalWriters<TSA>::writeField(w, t, *ofs);
+        ++ofs;
+    }
+};
+
+template<class Writer, class TSA, bool HasExternalWriters = ExternalWriters<TSA>::defined>
 struct MetaWriteHelper {
     typedef WriteHelper<
         Writer, TSA,
@@ -327,6 +617,11 @@ struct MetaWriteHelper {
     > type;
 };
 
+template<class Writer, class TSA>
+struct MetaWriteHelper<Writer, TSA, true> {
+    typedef ExternalWriteHelper<Writer, TSA> type;
+};
+
 
 template<class Writer, class TSA>
 inline void writeData(Writer& w, const TSA& t, OfsPopulateIter ofs)
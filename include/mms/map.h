@@ -37,6 +37,7 @@
 #include "impl/container.h"
 #include "impl/pair.h"
 #include "impl/fwd.h"
+#include "impl/rewrite.h"
 
 #include <map>
 #include <stdexcept>
@@ -62,6 +63,8 @@ public:
 
     static FormatVersion formatVersion(Versions& vs)
     { return vs.dependent<K, V>("map"); }
+    static bool needsLayout(impl::LayoutDeps& deps)
+    { return deps.dependent<K, V>(); }
 
     const V& operator [](const K& key) const { return at(key); }
 
@@ -80,6 +83,24 @@ public:
     }
 
     typedef map<Mmapped, K, V, Cmp> MmappedType;
+
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        impl::collectItems(e, Base::begin(), Base::size());
+    }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return impl::rewriteItems(w, Base::begin(), Base::size());
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeRef(w, pos, Base::size());
+    }
 };
 
 
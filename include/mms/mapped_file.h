@@ -0,0 +1,295 @@
+/*
+ * mms/mapped_file.h -- mapping serialized files into memory
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "cast.h"
+#include "impl/posix.h"
+#include "impl/prefault.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mms {
+
+/**
+ * How FileMapping maps a file. Defaults to what a plain
+ * mmap(PROT_READ, MAP_SHARED) does; knobs can be chained:
+ *
+ *   mms::MapPolicy().populate().advise(mms::MapPolicy::Random).lock(64 << 20)
+ *   mms::MapPolicy().prefault(8).bandwidth(500 << 20)
+ */
+class MapPolicy {
+public:
+    /// Access pattern passed to madvise()
+    enum Advice { Normal, Random, Sequential, WillNeed };
+
+    static const size_t WHOLE_FILE = static_cast<size_t>(-1);
+
+    MapPolicy():
+        populate_(false), prefault_(false), advice_(Normal), hugePages_(false),
+        lock_(0), private_(false)
+    {}
+
+    /// Read the whole file in while mapping it (MAP_POPULATE),
+    /// so no page faults are taken afterwards.
+    MapPolicy& populate(bool on = true) { populate_ = on; return *this; }
+
+    /// Read the whole file in after mapping it, touching its pages from
+    /// `threads' threads (0 stands for the number of CPUs; more than one
+    /// requires C++11). Unlike MAP_POPULATE, which faults pages in one
+    /// by one inside mmap(), this keeps several reads in flight.
+    MapPolicy& prefault(size_t threads = 0)
+    {
+        prefault_ = true;
+        prefaultOptions_.threads = threads;
+        return *this;
+    }
+
+    /// Have prefault() read no more than `bytesPerSecond' bytes a second
+    /// (0 for no limit), leaving some I/O to whoever shares the disk.
+    MapPolicy& bandwidth(size_t bytesPerSecond) { prefaultOptions_.bandwidth = bytesPerSecond; return *this; }
+
+    /// Bind prefault() threads to NUMA nodes in turn, so the file
+    /// ends up spread across the nodes' memory.
+    MapPolicy& numaNodes(bool on = true) { prefaultOptions_.numa = on; return *this; }
+
+    MapPolicy& advise(Advice advice) { advice_ = advice; return *this; }
+
+    /// Place the mapping at a huge page boundary and ask the kernel
+    /// to back it with transparent huge pages (MADV_HUGEPAGE). This is
+    /// only a hint: kernels without THP for files will use small pages.
+    MapPolicy& hugePages(bool on = true) { hugePages_ = on; return *this; }
+
+    /// Lock the first `size' bytes of the file in memory (mlock()),
+    /// which makes the mapping fail if RLIMIT_MEMLOCK is exceeded.
+    /// NB: locking a private mapping copies all the pages it locks.
+    MapPolicy& lock(size_t size = WHOLE_FILE) { lock_ = size; return *this; }
+
+    /// Map the file copy-on-write (MAP_PRIVATE) and writable, so that
+    /// transient fields can be set. Changes never reach the file.
+    MapPolicy& privateWritable(bool on = true) { private_ = on; return *this; }
+
+    bool populates() const { return populate_; }
+    bool prefaults() const { return prefault_; }
+    const impl::PrefaultOptions& prefaultOptions() const { return prefaultOptions_; }
+    Advice advice() const { return advice_; }
+    bool usesHugePages() const { return hugePages_; }
+    size_t lockSize() const { return lock_; }
+    bool isPrivate() const { return private_; }
+
+private:
+    bool populate_;
+    bool prefault_;
+    impl::PrefaultOptions prefaultOptions_;
+    Advice advice_;
+    bool hugePages_;
+    size_t lock_;
+    bool private_;
+};
+
+
+/**
+ * A mapping of a whole file, unmapped on destruction.
+ */
+class FileMapping {
+public:
+    static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    explicit FileMapping(const std::string& path, const MapPolicy& policy = MapPolicy()):
+        path_(path), data_(0), size_(0), lockedSize_(0), private_(policy.isPrivate()),
+        loadSeconds_(0)
+    {
+        double start = impl::monotonicSeconds();
+        int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            impl::throwSystemError("mms: cannot open " + path_);
+        try {
+            map(fd, policy);
+        }
+        catch (...) {
+            ::close(fd);
+            unmap();
+            throw;
+        }
+        ::close(fd);
+        loadSeconds_ = impl::monotonicSeconds() - start;
+    }
+
+    ~FileMapping() { unmap(); }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+    bool isPrivate() const { return private_; }
+
+    /// Number of bytes locked in memory
+    size_t lockedSize() const { return lockedSize_; }
+
+    /// Time the constructor took: with populate(), prefault() or lock()
+    /// this is how long it took for the file to become resident.
+    double loadSeconds() const { return loadSeconds_; }
+
+    /// Data of a private mapping, which may be modified
+    char* mutableData() const
+    {
+        if (!private_)
+            throw std::logic_error("mms: " + path_ + " is not mapped privately");
+        return data_;
+    }
+
+private:
+    std::string path_;
+    char* data_;
+    size_t size_;
+    size_t lockedSize_;
+    bool private_;
+    double loadSeconds_;
+
+    FileMapping(const FileMapping&);
+    FileMapping& operator = (const FileMapping&);
+
+    void map(int fd, const MapPolicy& policy)
+    {
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+            impl::throwSystemError("mms: cannot stat " + path_);
+        if (st.st_size == 0)
+            throw std::runtime_error("mms: " + path_ + " is empty");
+        size_t size = st.st_size;
+
+        int prot = PROT_READ | (private_ ? PROT_WRITE : 0);
+        int flags = (private_ ? MAP_PRIVATE : MAP_SHARED) | (policy.populates() ? MAP_POPULATE : 0);
+        void* addr = policy.usesHugePages() ? reserveAligned(size) : 0;
+        if (addr)
+            flags |= MAP_FIXED;
+        void* p = ::mmap(addr, size, prot, flags, fd, 0);
+        if (p == MAP_FAILED) {
+            // Release the reservation, which nothing else knows about
+            if (addr) {
+                int err = errno;
+                ::munmap(addr, size);
+                errno = err;
+            }
+            impl::throwSystemError("mms: cannot mmap " + path_);
+        }
+        data_ = static_cast<char*>(p);
+        size_ = size;
+
+#ifdef MADV_HUGEPAGE
+        // Best effort; fails if THP is not supported at all
+        if (policy.usesHugePages())
+            ::madvise(data_, size_, MADV_HUGEPAGE);
+#endif
+
+        static const int ADVICE[] = { MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED };
+        if (policy.advice() != MapPolicy::Normal
+            && ::madvise(data_, size_, ADVICE[policy.advice()]) != 0)
+        {
+            impl::throwSystemError("mms: cannot madvise " + path_);
+        }
+
+        if (policy.prefaults()) {
+            const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+            std::vector<impl::PageRange> ranges(1, impl::PageRange(
+                data_, data_ + ((size_ + pageSize - 1) & ~(pageSize - 1))));
+            impl::NoProgress progress;
+            impl::prefault(ranges, policy.prefaultOptions(), progress);
+        }
+
+        size_t locked = std::min(policy.lockSize(), size_);
+        if (locked) {
+            if (::mlock(data_, locked) != 0)
+                impl::throwSystemError("mms: cannot lock " + path_ + " in memory");
+            lockedSize_ = locked;
+        }
+    }
+
+    // Reserves address space for `size' bytes starting at a huge page
+    // boundary, to be replaced with the file mapping.
+    void* reserveAligned(size_t size)
+    {
+        size_t pageSize = ::sysconf(_SC_PAGESIZE);
+        size_t mapped = (size + pageSize - 1) & ~(pageSize - 1);
+        size_t reserved = mapped + HUGE_PAGE_SIZE;
+        void* p = ::mmap(0, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED)
+            impl::throwSystemError("mms: cannot reserve address space for " + path_);
+        char* begin = static_cast<char*>(p);
+        char* aligned = reinterpret_cast<char*>(
+            (reinterpret_cast<size_t>(begin) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+        if (aligned != begin)
+            ::munmap(begin, aligned - begin);
+        if (aligned + mapped != begin + reserved)
+            ::munmap(aligned + mapped, begin + reserved - aligned - mapped);
+        return aligned;
+    }
+
+    void unmap()
+    {
+        if (data_) {
+            ::munmap(data_, size_);
+            data_ = 0;
+        }
+    }
+};
+
+
+/**
+ * A file written with safeWrite(), mapped and cast to its root
+ * of type T, which should be an Mmapped type.
+ *
+ *   mms::MappedFile< Index<mms::Mmapped> > index("index.mms",
+ *       mms::MapPolicy().populate());
+ *   index->lookup(...);
+ */
+template<class T>
+class MappedFile: public FileMapping {
+public:
+    explicit MappedFile(const std::string& path, const MapPolicy& policy = MapPolicy()):
+        FileMapping(path, policy),
+        root_(&mms::safeCast<T>(data(), size()))
+    {}
+
+    const T& root() const { return *root_; }
+    const T& operator*() const { return *root_; }
+    const T* operator->() const { return root_; }
+
+private:
+    const T* root_;
+};
+
+} // namespace mms
@@ -0,0 +1,300 @@
+/*
+ * mms/memfd.h -- publishing serialized data in sealed memory file descriptors
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "cast.h"
+#include "impl/posix.h"
+#include "impl/mapped_buffer.h"
+
+#include <stdexcept>
+#include <string>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// Older C libraries lack these, though the kernel may well have them
+#ifndef MFD_CLOEXEC
+#    define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#    define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#    define F_ADD_SEALS 1033
+#    define F_GET_SEALS 1034
+#    define F_SEAL_SEAL 0x0001
+#    define F_SEAL_SHRINK 0x0002
+#    define F_SEAL_GROW 0x0004
+#    define F_SEAL_WRITE 0x0008
+#endif
+
+namespace mms {
+
+namespace impl {
+
+inline int memfdCreate(const std::string& name, unsigned flags)
+{
+#ifdef SYS_memfd_create
+    return static_cast<int>(::syscall(SYS_memfd_create, name.c_str(), flags));
+#else
+    (void) name; (void) flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+} // namespace impl
+
+
+/**
+ * A writer which stores data directly into an anonymous memory file
+ * (see memfd_create(2)), so it can be handed over to other processes
+ * as a file descriptor and mapped by them without any copying.
+ *
+ * seal() makes the contents immutable and returns the descriptor;
+ * it is up to the caller to close it once it has been passed on.
+ * Receivers should use SealedMapping, which makes sure the data
+ * cannot change or go away under their feet.
+ *
+ *   mms::MemfdWriter w("index");
+ *   mms::safeWrite(w, index);
+ *   int fd = w.seal();
+ *   mms::sendFd(sock, fd);
+ *   close(fd);
+ */
+class MemfdWriter: public impl::WriterBase {
+public:
+    static const size_t ALIGNMENT = impl::MappedBuffer::ALIGNMENT;
+
+    /// Seals set by seal(): no writes, no resizing, no unsealing.
+    static const int SEALS = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+    /// `name' is only informational; it shows in /proc/<pid>/fd.
+    explicit MemfdWriter(const std::string& name = "mms"):
+        name_(name), fd_(impl::memfdCreate(name, MFD_CLOEXEC | MFD_ALLOW_SEALING)),
+        buf_(fd_, "memfd " + name)
+    {
+        if (fd_ == -1)
+            impl::throwSystemError("mms: cannot create memfd " + name_);
+    }
+
+    ~MemfdWriter()
+    {
+        buf_.unmap();
+        if (fd_ != -1)
+            ::close(fd_);
+    }
+
+    void write(const void* data, size_t size)
+    {
+        buf_.grow(pos() + size);
+        memcpy(buf_.data() + pos(), data, size);
+        advance(size);
+    }
+
+    /// Allocates the memory file to be at least `size' bytes long.
+    void reserve(size_t size) { buf_.reserve(size); }
+
+    /// Truncates the memory file to the exact size of the data,
+    /// seals it and returns its descriptor, which the caller owns
+    /// from now on. The writer can no longer be used.
+    int seal()
+    {
+        buf_.unmap();
+        if (::ftruncate(fd_, pos()) != 0)
+            impl::throwSystemError("mms: cannot truncate memfd " + name_);
+        // F_SEAL_WRITE fails with EBUSY while writable mappings
+        // exist; ours is gone, and nobody else has seen the fd yet.
+        if (::fcntl(fd_, F_ADD_SEALS, SEALS) != 0)
+            impl::throwSystemError("mms: cannot seal memfd " + name_);
+        int fd = fd_;
+        fd_ = -1;
+        return fd;
+    }
+
+    int fd() const { return fd_; }
+    size_t capacity() const { return buf_.capacity(); }
+
+private:
+    std::string name_;
+    int fd_;
+    impl::MappedBuffer buf_;
+
+    MemfdWriter(const MemfdWriter&);
+    MemfdWriter& operator = (const MemfdWriter&);
+};
+
+
+/// Writes `t' into a new sealed memory file and returns its descriptor.
+template<class T>
+inline int publish(const T& t, const std::string& name = "mms")
+{
+    MemfdWriter w(name);
+    safeWrite(w, t);
+    return w.seal();
+}
+
+
+/**
+ * A read-only mapping of a memory file published with MemfdWriter.
+ *
+ * The descriptor is checked to be sealed against writes and shrinking;
+ * otherwise the sender could change data being read, or truncate it
+ * and have the receiver killed with SIGBUS.
+ *
+ *   mms::SealedMapping m(mms::receiveFd(sock));
+ *   const Index<mms::Mmapped>& index = m.safeCast< Index<mms::Mmapped> >();
+ */
+class SealedMapping {
+public:
+    /// Maps `fd' and closes it, whether mapping succeeds or not.
+    explicit SealedMapping(int fd): data_(0), size_(0)
+    {
+        try {
+            map(fd);
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    ~SealedMapping() { ::munmap(data_, size_); }
+
+    const char* data() const { return static_cast<const char*>(data_); }
+    size_t size() const { return size_; }
+
+    template<class T>
+    const T& safeCast() const { return mms::safeCast<T>(data(), size()); }
+
+    template<class T>
+    const T& unsafeCast() const { return mms::unsafeCast<T>(data(), size()); }
+
+private:
+    void* data_;
+    size_t size_;
+
+    SealedMapping(const SealedMapping&);
+    SealedMapping& operator = (const SealedMapping&);
+
+    void map(int fd)
+    {
+        static const int REQUIRED = F_SEAL_WRITE | F_SEAL_SHRINK;
+        int seals = ::fcntl(fd, F_GET_SEALS);
+        if (seals == -1)
+            impl::throwSystemError("mms: cannot get seals of a memfd");
+        if ((seals & REQUIRED) != REQUIRED)
+            throw std::runtime_error("mms: memfd is not sealed against modification");
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+            impl::throwSystemError("mms: cannot stat a memfd");
+        if (st.st_size == 0)
+            throw std::runtime_error("mms: memfd is empty");
+        void* p = ::mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            impl::throwSystemError("mms: cannot mmap a memfd");
+        data_ = p;
+        size_ = st.st_size;
+    }
+};
+
+
+/// Passes `fd' over a UNIX domain socket `sock'.
+inline void sendFd(int sock, int fd)
+{
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    while (::sendmsg(sock, &msg, MSG_NOSIGNAL) < 0)
+        if (errno != EINTR)
+            impl::throwSystemError("mms: cannot send a file descriptor");
+}
+
+/// Receives a file descriptor sent with sendFd() over `sock'.
+inline int receiveFd(int sock)
+{
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t received;
+    while ((received = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0)
+        if (errno != EINTR)
+            impl::throwSystemError("mms: cannot receive a file descriptor");
+    if (received == 0)
+        throw std::runtime_error("mms: connection closed while receiving a file descriptor");
+
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(c), sizeof(int));
+            return fd;
+        }
+    }
+    throw std::runtime_error("mms: no file descriptor received");
+}
+
+} // namespace mms
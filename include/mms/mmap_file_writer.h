@@ -0,0 +1,136 @@
+/*
+ * mms/mmap_file_writer.h -- a writer storing data right into a memory-mapped file
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "writer.h"
+#include "impl/posix.h"
+#include "impl/mapped_buffer.h"
+
+#include <string>
+#include <cstring>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
+namespace mms {
+
+/**
+ * A writer which stores data directly into a shared mapping of
+ * the output file, with no stream buffers and no copying through
+ * write() syscalls.
+ *
+ * Data is written to a temporary file next to `path'; commit()
+ * truncates it to the exact size, syncs it, renames it to `path'
+ * and syncs the directory, so readers see either the old file or
+ * the complete new one, even after a crash. If the writer is destroyed
+ * without commit(), the temporary file is removed.
+ *
+ * The file is extended in chunks as writing goes on. It is only
+ * allocated at once to its final size if the size is known up front:
+ * either the type needs the layout pass (which calls reserve()),
+ * or the caller reserves it explicitly. The latter costs an extra
+ * traversal of the data, but not of the output:
+ *
+ *   mms::MmapFileWriter w("index.mms");
+ *   w.reserve(mms::safeSerializedSize(index));
+ *   mms::safeWrite(w, index);
+ *   w.commit();
+ */
+class MmapFileWriter: public impl::WriterBase {
+public:
+    static const size_t ALIGNMENT = impl::MappedBuffer::ALIGNMENT;
+
+    explicit MmapFileWriter(const std::string& path, mode_t mode = 0644):
+        path_(path), tmpPath_(path + ".XXXXXX"),
+        fd_(mkstemp(&tmpPath_[0])), buf_(fd_, tmpPath_)
+    {
+        if (fd_ == -1)
+            impl::throwSystemError("mms: cannot create " + tmpPath_);
+        if (fchmod(fd_, mode) != 0) {
+            discard();
+            impl::throwSystemError("mms: cannot chmod " + tmpPath_);
+        }
+    }
+
+    ~MmapFileWriter() { discard(); }
+
+    void write(const void* data, size_t size)
+    {
+        buf_.grow(pos() + size);
+        memcpy(buf_.data() + pos(), data, size);
+        advance(size);
+    }
+
+    /// Allocates the file to be at least `size' bytes long.
+    void reserve(size_t size) { buf_.reserve(size); }
+
+    /// Publishes the file under its final name.
+    /// If `sync' is set, data is flushed to disk before renaming,
+    /// and the directory entry right after it.
+    void commit(bool sync = true)
+    {
+        buf_.unmap();
+        if (ftruncate(fd_, pos()) != 0)
+            impl::throwSystemError("mms: cannot truncate " + tmpPath_);
+        if (sync && fdatasync(fd_) != 0)
+            impl::throwSystemError("mms: cannot sync " + tmpPath_);
+        if (::rename(tmpPath_.c_str(), path_.c_str()) != 0)
+            impl::throwSystemError("mms: cannot rename " + tmpPath_ + " to " + path_);
+        ::close(fd_);
+        fd_ = -1;
+        if (sync)
+            impl::syncParentDir(path_);
+    }
+
+    const std::string& path() const { return path_; }
+    size_t capacity() const { return buf_.capacity(); }
+
+private:
+    std::string path_;
+    std::string tmpPath_;
+    int fd_;
+    impl::MappedBuffer buf_;
+
+    MmapFileWriter(const MmapFileWriter&);
+    MmapFileWriter& operator = (const MmapFileWriter&);
+
+    void discard()
+    {
+        buf_.unmap();
+        if (fd_ != -1) {
+            ::close(fd_);
+            ::unlink(tmpPath_.c_str());
+            fd_ = -1;
+        }
+    }
+};
+
+} // namespace mms
@@ -37,6 +37,7 @@
 #include "impl/fwd.h"
 #include "impl/tags.h"
 #include "impl/container.h"
+#include "impl/rewrite.h"
 
 namespace mms {
 
@@ -104,8 +105,29 @@ public:
 
     static FormatVersion formatVersion(Versions& vs)
         { return vs.dependent<T>("optional"); }
+    static bool needsLayout(impl::LayoutDeps& deps)
+        { return deps.dependent<T>(); }
 
     typedef optional<Mmapped, T> MmappedType;
+
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        if (is_initialized())
+            impl::collectItems(e, ptr<T>(), 1);
+    }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return is_initialized() ? impl::write(w, *ptr<T>()) : impl::nullOfs();
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeOffset(w, pos);
+    }
 };
 
 
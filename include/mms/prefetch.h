@@ -0,0 +1,208 @@
+/*
+ * mms/prefetch.h -- warming up pages of mmapped data
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "impl/config.h"
+#include "impl/rewrite.h"
+#include "impl/prefault.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <unistd.h>
+
+namespace mms {
+
+enum PrefetchMethod {
+    /// Ask the kernel to read pages in (madvise(MADV_WILLNEED))
+    /// and return without waiting for it.
+    PrefetchAdvise,
+
+    /// Read a byte from each page, so that all of them are
+    /// resident once prefetch() returns.
+    PrefetchTouch
+};
+
+/**
+ * What prefetch() warms, and how:
+ *
+ *   mms::PrefetchPolicy().depth(1).method(mms::PrefetchTouch).threads(4)
+ */
+class PrefetchPolicy {
+public:
+    static const size_t UNLIMITED = static_cast<size_t>(-1);
+
+    PrefetchPolicy(): depth_(UNLIMITED), method_(PrefetchTouch) {}
+
+    /// How many levels of containers to follow: 1 warms bodies of
+    /// containers in the object itself, 2 also warms whatever their
+    /// elements refer to, and so on.
+    PrefetchPolicy& depth(size_t depth) { depth_ = depth; return *this; }
+
+    PrefetchPolicy& method(PrefetchMethod method) { method_ = method; return *this; }
+
+    /// Number of threads touching pages (0 stands for the number
+    /// of CPUs; more than one requires C++11).
+    PrefetchPolicy& threads(size_t threads) { prefault_.threads = threads; return *this; }
+
+    /// Pages are warmed (and progress is reported) in chunks of this size.
+    PrefetchPolicy& chunkSize(size_t size) { prefault_.chunkSize = size; return *this; }
+
+    /// Warm no more than `bytesPerSecond' bytes a second (0 for no limit),
+    /// so as not to starve other users of the disk.
+    PrefetchPolicy& bandwidth(size_t bytesPerSecond) { prefault_.bandwidth = bytesPerSecond; return *this; }
+
+    /// Bind threads to NUMA nodes in turn, spreading warmed pages
+    /// across the nodes.
+    PrefetchPolicy& numaNodes(bool on = true) { prefault_.numa = on; return *this; }
+
+    size_t depth() const { return depth_; }
+    PrefetchMethod method() const { return method_; }
+    size_t threads() const { return prefault_.threads; }
+    size_t chunkSize() const { return prefault_.chunkSize; }
+    size_t bandwidth() const { return prefault_.bandwidth; }
+    bool numaNodes() const { return prefault_.numa; }
+
+    impl::PrefaultOptions prefaultOptions() const
+    {
+        impl::PrefaultOptions opts = prefault_;
+        opts.advise = (method_ == PrefetchAdvise);
+        return opts;
+    }
+
+private:
+    size_t depth_;
+    PrefetchMethod method_;
+    impl::PrefaultOptions prefault_;
+};
+
+struct PrefetchStats {
+    /// Contiguous page ranges found
+    size_t ranges;
+
+    /// Bytes in those ranges (whole pages)
+    size_t bytes;
+
+    /// Objects whose pointees could not be seen (they have neither
+    /// traverseFields() nor collectPointees()), and so were not warmed
+    size_t opaque;
+
+    PrefetchStats(): ranges(0), bytes(0), opaque(0) {}
+};
+
+namespace impl {
+
+/// Collects pages an mmapped object refers to, down to a given depth.
+class PrefetchExtent {
+public:
+    typedef PageRange Range;
+
+    explicit PrefetchExtent(size_t maxDepth):
+        maxDepth_(maxDepth), depth_(0), opaque_(0),
+        pageSize_(::sysconf(_SC_PAGESIZE))
+    {}
+
+    void add(const void* ptr, size_t size, size_t /*alignment*/)
+    {
+        addPages(ranges_, ptr, size, pageSize_);
+    }
+
+    void unknown() { ++opaque_; }
+
+    bool enter()
+    {
+        if (depth_ + 1 >= maxDepth_)
+            return false;
+        ++depth_;
+        return true;
+    }
+
+    void leave() { --depth_; }
+
+    void enterField(const char*, size_t) {}
+    void leaveField() {}
+
+    /// Sorts and merges collected ranges, returning them.
+    const std::vector<Range>& ranges()
+    {
+        mergePages(ranges_);
+        return ranges_;
+    }
+
+    size_t opaque() const { return opaque_; }
+    size_t pageSize() const { return pageSize_; }
+
+private:
+    std::vector<Range> ranges_;
+    size_t maxDepth_;
+    size_t depth_;
+    size_t opaque_;
+    size_t pageSize_;
+};
+
+} // namespace impl
+
+
+/**
+ * Brings pages of mmapped `obj' into memory, following the containers
+ * it consists of down to the depth set in `policy'. Only the pages
+ * holding what is reached are warmed, so lookup structures can be warmed
+ * without the bulky payloads their elements refer to.
+ *
+ * Finding out what to warm reads all levels above the deepest one.
+ *
+ * `progress(bytesDone, bytesTotal)' is called after each chunk
+ * of pages is warmed (serially, though maybe on different threads).
+ */
+template<class TMM, class Progress>
+PrefetchStats prefetch(const TMM& obj, const PrefetchPolicy& policy, Progress progress)
+{
+    PrefetchStats stats;
+    if (!policy.depth())
+        return stats;
+
+    impl::PrefetchExtent e(policy.depth());
+    e.add(&obj, sizeof(TMM), 1);
+    impl::collectPointees(e, obj);
+    const std::vector<impl::PrefetchExtent::Range>& ranges = e.ranges();
+    stats.ranges = ranges.size();
+    stats.opaque = e.opaque();
+
+    stats.bytes = impl::prefault(ranges, policy.prefaultOptions(), progress);
+    return stats;
+}
+
+template<class TMM>
+PrefetchStats prefetch(const TMM& obj, const PrefetchPolicy& policy = PrefetchPolicy())
+{
+    return prefetch(obj, policy, impl::NoProgress());
+}
+
+} // namespace mms
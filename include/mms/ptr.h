@@ -42,58 +42,32 @@ namespace mms {
 
 namespace impl {
 
-class LayoutHelper;
 template<class T> class PtrBase;
 
+// Precedes every pointee in memory, just to make sure it has been
+// allocated with Pointee::operator new(). What writers know about
+// pointees is kept by writers themselves (see PointeeMap).
 class PointeeHeader {
 private:
     static const uint32_t Magic = 0x00445450; // = "PTD\0";
-    static const size_t PosMask = ~size_t(1);
-    static const size_t HasPos = 1;
 
 public:
-    PointeeHeader(): magic_(Magic), writerId_(), pos_(0) {}
+    PointeeHeader(): magic_(Magic) {}
 
     template<class T>
-    static PointeeHeader& get(T* ptr)
+    static const PointeeHeader& get(const T* ptr)
     {
-        char* p = reinterpret_cast<char*>(ptr);
-        PointeeHeader* hdr = reinterpret_cast<PointeeHeader*>(p - sizeof(PointeeHeader));
+        const char* p = reinterpret_cast<const char*>(ptr);
+        const PointeeHeader* hdr = reinterpret_cast<const PointeeHeader*>(p - sizeof(PointeeHeader));
         if (hdr->magic_ != Magic)
             throw std::logic_error("pointee magic not found (pointee allocated on stack?)");
         return *hdr;
     }
 
-    template<class Writer>
-    bool isWritten(Writer* writer) const { return writerId_ == writer->id(); }
-
-    size_t position() const { return pos_ & PosMask; }
-
-    template<class Writer>
-    void beganWriting(Writer* writer) { writerId_ = writer->id(); }
-
-    void beganWriting(LayoutHelper* writer)
-    {
-        if (writer->id() != writerId_ && writer->writer()->id() != writerId_) {
-            // Will write to another writer, clean up from previous write
-            pos_ = 0;
-            writer->addPointee(pos_);
-        }
-        writerId_ = writer->id();
-    }
-
-    void endedWriting(size_t pos)
-    {
-        if (pos & ~PosMask)
-            throw std::logic_error("object position is not a multiple of machine-word-size");
-        if (!(pos_ & HasPos)) pos_ = pos | HasPos;
-    }
-    void clean() { pos_ = 0; }
-
 private:
     uint32_t magic_;
-    WriterID writerId_;
-    size_t pos_;
+    // Keeps pointees as aligned as operator new() would
+    char padding_[2 * sizeof(void*) - sizeof(uint32_t)];
 };
 
 } // namespace impl
@@ -177,6 +151,10 @@ public:
     static FormatVersion formatVersion(Versions& vs)
         { return vs.dependent<T>("ptr"); }
 
+    // Pointee positions must be known before they are written
+    // (think of back references), which is what layout pass is for.
+    static bool needsLayout(impl::LayoutDeps&) { return true; }
+
 private:
     Offset ofs_;
 };
@@ -202,13 +180,16 @@ public:
         //    the exact location of pointees in output stream;
         // 2) with Writer=mms::Writer to perform actual writing.
 
-        if (H::get()) {
-            impl::PointeeHeader& hdr = impl::PointeeHeader::get(H::get());
-            if (!hdr.isWritten(&w)) {
-                hdr.beganWriting(&w);
-                hdr.endedWriting(impl::write(w, *H::get()));
-            }
-            return hdr.position();
+        // Pointees are only read here, so objects sharing them
+        // may be written by several writers at once.
+        if (const element_type* p = H::get()) {
+            impl::PointeeHeader::get(p);
+            impl::PointeeMap& pointees = w.pointees();
+            size_t pos;
+            if (pointees.written(p, pos))
+                return pos;
+            pointees.beganWriting(p);
+            return pointees.endedWriting(p, impl::write(w, *p));
         } else {
             return impl::nullOfs();
         }
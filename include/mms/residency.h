@@ -0,0 +1,393 @@
+/*
+ * mms/residency.h -- which fields of mapped data are in memory, and which are used
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "mapped_file.h"
+#include "impl/rewrite.h"
+#include "impl/prefault.h"
+#include "impl/posix.h"
+#include "impl/field_paths.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace mms {
+
+/// Memory of a field, a container or elements of one
+struct ResidencyRow {
+    /// Like "index", "index[]" (elements of a container),
+    /// "index[].second" or "#2" (a field with no name)
+    std::string path;
+
+    /// Bytes of data
+    size_t bytes;
+
+    /// Pages holding any of the data (a page may be shared
+    /// by several rows)
+    size_t pages;
+
+    /// Those of the pages in memory
+    size_t residentPages;
+
+    /// Those of the pages accessed during at least one sample
+    size_t accessedPages;
+
+    /// Accesses to the pages, one per page per sample at most
+    size_t accesses;
+
+    /// Objects whose pointees could not be seen (e.g. ptr<>)
+    size_t opaque;
+
+    ResidencyRow():
+        bytes(0), pages(0), residentPages(0), accessedPages(0), accesses(0), opaque(0)
+    {}
+};
+
+namespace impl {
+
+/// Attributes memory an mmapped object refers to to paths of fields.
+class FieldExtents {
+public:
+    struct Extent {
+        size_t bytes;
+        size_t opaque;
+        std::vector<PageRange> pages;
+
+        Extent(): bytes(0), opaque(0) {}
+    };
+
+    explicit FieldExtents(size_t pageSize):
+        extents_(1), current_(FieldPaths::ROOT), pageSize_(pageSize)
+    {}
+
+    void add(const void* ptr, size_t size, size_t /*alignment*/)
+    {
+        Extent& e = extents_[current_];
+        e.bytes += size;
+        addPages(e.pages, ptr, size, pageSize_);
+    }
+
+    void unknown() { ++extents_[current_].opaque; }
+
+    bool enter()
+    {
+        moveTo(paths_.elements(current_));
+        return true;
+    }
+
+    void leave() { current_ = paths_.parent(current_); }
+
+    void enterField(const char* name, size_t index) { moveTo(paths_.field(current_, name, index)); }
+    void leaveField() { current_ = paths_.parent(current_); }
+
+    const FieldPaths& paths() const { return paths_; }
+    std::vector<Extent>& extents() { return extents_; }
+    const std::vector<Extent>& extents() const { return extents_; }
+
+private:
+    FieldPaths paths_;
+    std::vector<Extent> extents_;
+    size_t current_;
+    size_t pageSize_;
+
+    void moveTo(size_t path)
+    {
+        current_ = path;
+        if (extents_.size() < paths_.size())
+            extents_.resize(paths_.size());
+    }
+};
+
+} // namespace impl
+
+
+/**
+ * Tells which fields and containers of mmapped data own which pages,
+ * how many of those are in memory (per mincore()) and, if sampled,
+ * how many are actually used:
+ *
+ *   mms::MappedFile< Index<mms::Mmapped> > index("index.mms");
+ *   mms::ResidencyMap map(index);
+ *   for (...) {
+ *       map.startSample();
+ *       serveForAWhile();
+ *       map.endSample();
+ *   }
+ *   map.print(std::cout);
+ *
+ * Name fields with mms::field() in traverseFields() to see their
+ * names in paths rather than their numbers.
+ *
+ * Sampling works on pages of a file mapping: startSample() unmaps them
+ * with MADV_DONTNEED (which keeps them in the page cache), and
+ * endSample() sees which ones have been faulted back since, in
+ * /proc/self/pagemap. So the first access to a page in a sample costs
+ * a minor fault, and the kernel may map a few neighbours of a page
+ * along with it (see fault_around_bytes). Idle page tracking, which
+ * is exact, requires CAP_SYS_ADMIN; soft-dirty bits only track writes.
+ * Locked pages (see mlock() and MapPolicy::lock()) cannot be unmapped,
+ * so they are left alone: they stay resident and never count
+ * as accessed.
+ */
+class ResidencyMap {
+public:
+    /// Walks `root'; access sampling is not available.
+    template<class TMM>
+    explicit ResidencyMap(const TMM& root):
+        pageSize_(::sysconf(_SC_PAGESIZE)), fields_(pageSize_), file_(0), samples_(0)
+    {
+        build(root);
+    }
+
+    /// Walks the root of `file', and accounts its pages
+    /// not referred to from anywhere.
+    template<class TMM>
+    explicit ResidencyMap(const MappedFile<TMM>& file):
+        pageSize_(::sysconf(_SC_PAGESIZE)), fields_(pageSize_), file_(&file), samples_(0)
+    {
+        accesses_.resize((file.size() + pageSize_ - 1) / pageSize_);
+        locked_.resize(accesses_.size());
+        build(*file);
+    }
+
+    /// Unmaps pages of the file, so that accesses to them can be seen.
+    void startSample()
+    {
+        if (!file_)
+            throw std::logic_error("mms: sampling accesses requires a MappedFile");
+        if (file_->isPrivate())
+            throw std::logic_error("mms: sampling accesses would discard changes to a private mapping");
+        std::fill(locked_.begin(), locked_.end(), false);
+        unmap(0, filePages());
+    }
+
+    /// Records pages accessed since startSample().
+    void endSample()
+    {
+        if (!file_)
+            throw std::logic_error("mms: sampling accesses requires a MappedFile");
+        std::vector<uint64_t> entries(filePages());
+        int fd = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            impl::throwSystemError("mms: cannot open /proc/self/pagemap");
+        off_t ofs = reinterpret_cast<size_t>(file_->data()) / pageSize_ * sizeof(uint64_t);
+        ssize_t len = ::pread(fd, &entries[0], entries.size() * sizeof(uint64_t), ofs);
+        ::close(fd);
+        if (len != static_cast<ssize_t>(entries.size() * sizeof(uint64_t)))
+            impl::throwSystemError("mms: cannot read /proc/self/pagemap");
+        static const uint64_t PRESENT = static_cast<uint64_t>(1) << 63;
+        for (size_t i = 0; i != entries.size(); ++i)
+            if ((entries[i] & PRESENT) && !locked_[i])
+                ++accesses_[i];
+        ++samples_;
+    }
+
+    size_t samples() const { return samples_; }
+
+    /// Pages the last startSample() has found locked in memory
+    size_t lockedPages() const { return std::count(locked_.begin(), locked_.end(), true); }
+
+    /// A row for each field and container owning any memory, followed by
+    /// "(unreferenced)" (for a file, if any) and "(total)" rows.
+    std::vector<ResidencyRow> rows() const
+    {
+        std::vector<ResidencyRow> result;
+        const std::vector<impl::FieldExtents::Extent>& extents = fields_.extents();
+        std::vector<impl::PageRange> all;
+        ResidencyRow total;
+        total.path = "(total)";
+        for (size_t i = 0; i != extents.size(); ++i) {
+            if (!extents[i].bytes && !extents[i].opaque)
+                continue;
+            ResidencyRow row;
+            row.path = path(i);
+            row.bytes = extents[i].bytes;
+            row.opaque = extents[i].opaque;
+            count(row, extents[i].pages);
+            result.push_back(row);
+            all.insert(all.end(), extents[i].pages.begin(), extents[i].pages.end());
+            total.bytes += row.bytes;
+            total.opaque += row.opaque;
+        }
+        impl::mergePages(all);
+
+        if (file_) {
+            std::vector<impl::PageRange> unreferenced;
+            const char* p = file_->data();
+            for (size_t i = 0; i != all.size(); p = all[i++].end)
+                if (all[i].begin > p)
+                    unreferenced.push_back(impl::PageRange(p, all[i].begin));
+            const char* end = file_->data() + filePages() * pageSize_;
+            if (p < end)
+                unreferenced.push_back(impl::PageRange(p, end));
+            if (!unreferenced.empty()) {
+                ResidencyRow row;
+                row.path = "(unreferenced)";
+                count(row, unreferenced);
+                result.push_back(row);
+                all.insert(all.end(), unreferenced.begin(), unreferenced.end());
+                impl::mergePages(all);
+            }
+        }
+        count(total, all);
+        result.push_back(total);
+        return result;
+    }
+
+    /// Paths of fields owning data on the page holding `ptr'.
+    std::vector<std::string> owners(const void* ptr) const
+    {
+        std::vector<std::string> result;
+        const char* p = static_cast<const char*>(ptr);
+        const std::vector<impl::FieldExtents::Extent>& extents = fields_.extents();
+        for (size_t i = 0; i != extents.size(); ++i) {
+            const std::vector<impl::PageRange>& pages = extents[i].pages;
+            std::vector<impl::PageRange>::const_iterator r = std::upper_bound(
+                pages.begin(), pages.end(), impl::PageRange(p, p));
+            if (r != pages.begin() && p < (r - 1)->end)
+                result.push_back(path(i));
+        }
+        return result;
+    }
+
+    /// Prints rows() as a table.
+    void print(std::ostream& out) const
+    {
+        std::vector<ResidencyRow> rs = rows();
+        size_t width = 4;
+        for (size_t i = 0; i != rs.size(); ++i)
+            width = std::max(width, rs[i].path.size());
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%-*s %14s %10s %10s %7s", int(width),
+            "path", "bytes", "pages", "resident", "%");
+        out << buf;
+        if (samples_) {
+            snprintf(buf, sizeof(buf), " %10s %12s", "accessed", "accesses");
+            out << buf;
+        }
+        out << "\n";
+        for (size_t i = 0; i != rs.size(); ++i) {
+            const ResidencyRow& r = rs[i];
+            snprintf(buf, sizeof(buf), "%-*s %14zu %10zu %10zu %6.1f%%", int(width),
+                r.path.c_str(), r.bytes, r.pages, r.residentPages,
+                r.pages ? 100.0 * r.residentPages / r.pages : 0.0);
+            out << buf;
+            if (samples_) {
+                snprintf(buf, sizeof(buf), " %10zu %12zu", r.accessedPages, r.accesses);
+                out << buf;
+            }
+            if (r.opaque)
+                out << "  (" << r.opaque << " opaque)";
+            out << "\n";
+        }
+    }
+
+private:
+    size_t pageSize_;
+    impl::FieldExtents fields_;
+    const FileMapping* file_;
+    std::vector<unsigned> accesses_;
+    std::vector<bool> locked_;
+    size_t samples_;
+
+    ResidencyMap(const ResidencyMap&);
+    ResidencyMap& operator = (const ResidencyMap&);
+
+    template<class TMM>
+    void build(const TMM& root)
+    {
+        fields_.add(&root, sizeof(TMM), 1);
+        impl::collectPointees(fields_, root);
+        std::vector<impl::FieldExtents::Extent>& extents = fields_.extents();
+        for (size_t i = 0; i != extents.size(); ++i)
+            impl::mergePages(extents[i].pages);
+    }
+
+    std::string path(size_t i) const
+    {
+        return i == impl::FieldPaths::ROOT ? "(root)" : fields_.paths().str(i);
+    }
+
+    size_t filePages() const { return (file_->size() + pageSize_ - 1) / pageSize_; }
+
+    // Unmaps pages [begin, end) of the file. madvise() refuses to touch
+    // locked ranges with EINVAL, so such ranges are split until the pages
+    // which are locked are found.
+    void unmap(size_t begin, size_t end)
+    {
+        if (begin == end)
+            return;
+        char* p = const_cast<char*>(file_->data()) + begin * pageSize_;
+        if (::madvise(p, (end - begin) * pageSize_, MADV_DONTNEED) == 0)
+            return;
+        if (errno != EINVAL)
+            impl::throwSystemError("mms: madvise(MADV_DONTNEED) failed");
+        if (end - begin == 1) {
+            locked_[begin] = true;
+            return;
+        }
+        size_t middle = begin + (end - begin) / 2;
+        unmap(begin, middle);
+        unmap(middle, end);
+    }
+
+    void count(ResidencyRow& row, const std::vector<impl::PageRange>& pages) const
+    {
+        std::vector<unsigned char> resident;
+        for (size_t i = 0; i != pages.size(); ++i) {
+            size_t n = pages[i].size() / pageSize_;
+            row.pages += n;
+            resident.resize(n);
+            if (::mincore(const_cast<char*>(pages[i].begin), pages[i].size(), &resident[0]) != 0)
+                impl::throwSystemError("mms: mincore() failed");
+            for (size_t j = 0; j != n; ++j)
+                row.residentPages += resident[j] & 1;
+
+            if (!file_ || !samples_)
+                continue;
+            size_t first = (pages[i].begin - file_->data()) / pageSize_;
+            for (size_t j = first, je = std::min(first + n, accesses_.size()); j < je; ++j) {
+                row.accessedPages += (accesses_[j] != 0);
+                row.accesses += accesses_[j];
+            }
+        }
+    }
+};
+
+} // namespace mms
@@ -36,6 +36,7 @@
 #include "impl/tags.h"
 #include "impl/container.h"
 #include "impl/fwd.h"
+#include "impl/rewrite.h"
 
 #include <set>
 #include <stdexcept>
@@ -53,8 +54,28 @@ class set<Mmapped, T, Cmp>: public impl::SortedSequence<T, T, Cmp<T>, impl::Iden
 public:
     static FormatVersion formatVersion(Versions& vs)
         { return vs.dependent<T>("set"); }
+    static bool needsLayout(impl::LayoutDeps& deps)
+        { return deps.dependent<T>(); }
 
     typedef set<Mmapped, T, Cmp> MmappedType;
+
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        impl::collectItems(e, this->begin(), this->size());
+    }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return impl::rewriteItems(w, this->begin(), this->size());
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeRef(w, pos, this->size());
+    }
 };
 
 
@@ -0,0 +1,268 @@
+/*
+ * mms/std.h -- writing standard containers as they are, without
+ *              converting them to mms::*<Standalone> first
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "type_traits.h"
+#include "writer.h"
+#include "vector.h"
+#include "string.h"
+#include "map.h"
+#include "set.h"
+#include "optional.h"
+#include "impl/config.h"
+
+#include <deque>
+#include <iterator>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#if MMS_USE_CXX11
+#   include <array>
+#endif
+
+#if __cplusplus >= 201703L && defined(MMS_FEATURES_OPTIONAL)
+#   include <optional>
+#   define MMS_STD_OPTIONAL 1
+#endif
+
+/*
+ * Including this header lets the following be passed to mms::write()
+ * (and be used as elements of other containers) as they are:
+ *
+ *   std::vector, std::deque, std::list   written as mms::vector
+ *   std::string                          written as mms::string
+ *   std::map, std::set                   written as mms::map and mms::set
+ *   std::pair                            (always supported)
+ *   std::array                           written as a struct of N fields
+ *   std::optional (C++17)                written as mms::optional
+ *   mms::range(begin, end)               written as mms::vector
+ *
+ * Written data is exactly the same as that of corresponding mms types
+ * and is read back with them. Comparators of maps and sets must be
+ * class templates taking a key type, like std::less.
+ */
+
+namespace mms {
+
+namespace impl {
+
+template<class T, class A>
+struct MmappedTypeAux<std::vector<T, A>, false> {
+    typedef vector<Mmapped, typename MmappedType<T>::type> type;
+};
+
+template<class T, class A>
+struct MmappedTypeAux<std::deque<T, A>, false> {
+    typedef vector<Mmapped, typename MmappedType<T>::type> type;
+};
+
+template<class T, class A>
+struct MmappedTypeAux<std::list<T, A>, false> {
+    typedef vector<Mmapped, typename MmappedType<T>::type> type;
+};
+
+template<class Traits, class A>
+struct MmappedTypeAux<std::basic_string<char, Traits, A>, false> {
+    typedef string<Mmapped> type;
+};
+
+template<class K, class V, template<class> class Cmp, class A>
+struct MmappedTypeAux<std::map<K, V, Cmp<K>, A>, false> {
+    typedef map<
+        Mmapped,
+        typename MmappedType<K>::type,
+        typename MmappedType<V>::type,
+        Cmp
+    > type;
+};
+
+template<class T, template<class> class Cmp, class A>
+struct MmappedTypeAux<std::set<T, Cmp<T>, A>, false> {
+    typedef set<Mmapped, typename MmappedType<T>::type, Cmp> type;
+};
+
+
+// Sequences other than std::vector are not contiguous, so their
+// elements are always written one by one.
+template<class C>
+struct SequenceWriters {
+    static const bool defined = true;
+
+    template<class Writer>
+    static size_t writeData(Writer& w, const C& c)
+    {
+        return writeRange<typename C::value_type>(w, c.begin(), c.end());
+    }
+
+    template<class Writer>
+    static size_t writeField(Writer& w, const C& c, size_t pos)
+    {
+        return writeRef(w, pos, c.size());
+    }
+};
+
+template<class T, class A>
+struct ExternalWriters< std::vector<T, A> >: SequenceWriters< std::vector<T, A> > {
+    template<class Writer>
+    static size_t writeData(Writer& w, const std::vector<T, A>& v)
+    {
+        return vector_impl::WriteSelector<
+                    mms::type_traits::is_trivial<T>::value &&
+                    !mms::type_traits::is_same<T, bool>::value, T>()(
+                w, v.begin(), v.end());
+    }
+};
+
+template<class T, class A>
+struct ExternalWriters< std::deque<T, A> >: SequenceWriters< std::deque<T, A> > {};
+
+template<class T, class A>
+struct ExternalWriters< std::list<T, A> >: SequenceWriters< std::list<T, A> > {};
+
+template<class K, class V, class Cmp, class A>
+struct ExternalWriters< std::map<K, V, Cmp, A> >: SequenceWriters< std::map<K, V, Cmp, A> > {};
+
+template<class T, class Cmp, class A>
+struct ExternalWriters< std::set<T, Cmp, A> >: SequenceWriters< std::set<T, Cmp, A> > {};
+
+template<class Traits, class A>
+struct ExternalWriters< std::basic_string<char, Traits, A> > {
+    static const bool defined = true;
+
+    template<class Writer>
+    static size_t writeData(Writer& w, const std::basic_string<char, Traits, A>& s)
+    {
+        return writeString(w, s.c_str(), s.size());
+    }
+
+    template<class Writer>
+    static size_t writeField(Writer& w, const std::basic_string<char, Traits, A>& s, size_t pos)
+    {
+        return writeRef(w, pos, s.size());
+    }
+};
+
+
+#if MMS_USE_CXX11
+
+// Arrays of trivial types are trivial themselves, and are written
+// as they are; others are written as structs with N fields.
+template<class T, size_t N>
+struct MmappedTypeAux<std::array<T, N>, false> {
+    typedef std::array<typename MmappedType<T>::type, N> type;
+};
+
+template<class T, size_t N>
+struct HasTraverseFields< std::array<T, N> > {
+    static const bool value = !mms::type_traits::is_trivial<T>::value;
+};
+
+template<class T, size_t N, class A>
+void traverseFields(const std::array<T, N>& arr, A a)
+{
+    for (size_t i = 0; i != N; ++i)
+        a(arr[i]);
+}
+
+#endif // MMS_USE_CXX11
+
+
+#ifdef MMS_STD_OPTIONAL
+
+template<class T>
+struct MmappedTypeAux<std::optional<T>, false> {
+    typedef optional<Mmapped, typename MmappedType<T>::type> type;
+};
+
+template<class T>
+struct ExternalWriters< std::optional<T> > {
+    static const bool defined = true;
+
+    template<class Writer>
+    static size_t writeData(Writer& w, const std::optional<T>& opt)
+    {
+        return opt ? impl::write(w, *opt) : nullOfs();
+    }
+
+    template<class Writer>
+    static size_t writeField(Writer& w, const std::optional<T>&, size_t pos)
+    {
+        return writeOffset(w, pos);
+    }
+};
+
+#endif // MMS_STD_OPTIONAL
+
+} // namespace impl
+
+
+/**
+ * Elements between two iterators, written as an mms::vector of them.
+ * Lets data be written right from where it is (a part of a container,
+ * a generator, etc.), as long as it can be iterated over several times.
+ * Keeps the iterators only; the elements must outlive the range.
+ */
+template<class Iter>
+class Range {
+public:
+    typedef typename std::iterator_traits<Iter>::value_type value_type;
+    typedef vector<Mmapped, typename impl::MmappedType<value_type>::type> MmappedType;
+
+    Range(Iter begin, Iter end): begin_(begin), end_(end) {}
+
+    Iter begin() const { return begin_; }
+    Iter end() const { return end_; }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return impl::writeRange<value_type>(w, begin_, end_);
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeRef(w, pos, std::distance(begin_, end_));
+    }
+
+private:
+    Iter begin_;
+    Iter end_;
+};
+
+template<class Iter>
+inline Range<Iter> range(Iter begin, Iter end) { return Range<Iter>(begin, end); }
+
+template<class C>
+inline Range<typename C::const_iterator> range(const C& c) { return range(c.begin(), c.end()); }
+
+} // namespace mms
@@ -33,6 +33,7 @@
 #include "impl/tags.h"
 #include "impl/container.h"
 #include "impl/fwd.h"
+#include "impl/rewrite.h"
 
 #include <iostream>
 #include <string>
@@ -41,6 +42,28 @@
 
 namespace mms {
 
+namespace impl {
+
+// Writes a zero-terminated string of `size' chars, unless the writer
+// has an equal one interned already; returns its position.
+template<class Writer>
+inline size_t writeString(Writer& w, const char* str, size_t size)
+{
+    StringPool* pool = w.stringPool();
+    size_t res;
+    if (pool && pool->find(str, size, res))
+        return res;
+
+    align(w);
+    res = w.pos();
+    w.write(str, size + 1); // +1 for trailing zero
+    if (pool)
+        pool->add(str, size, res);
+    return res;
+}
+
+} // namespace impl
+
 
 template<>
 class string<Mmapped>: public impl::Sequence<char>
@@ -48,6 +71,7 @@ class string<Mmapped>: public impl::Sequence<char>
 public:
     static FormatVersion formatVersion(Versions& vs)
         { return vs.hash("string"); }
+    static bool needsLayout(impl::LayoutDeps&) { return false; }
 
     // Sequence<char>::size() stores length of string
     // (not including stored trailing zero)
@@ -71,6 +95,24 @@ public:
 
     typedef string<Mmapped> MmappedType;
 
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        e.add(c_str(), size() + 1, sizeof(void*));
+    }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return impl::writeString(w, c_str(), size());
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeRef(w, pos, size());
+    }
+
 private:
     static const char* zero() { static const char z = 0; return &z; }
 };
@@ -111,10 +153,7 @@ public:
     template<class Writer>
     size_t writeData(Writer& w) const
     {
-        impl::align(w);
-        size_t res = w.pos();
-        w.write(c_str(), size() + 1); // +1 for trailing zero
-        return res;
+        return impl::writeString(w, c_str(), size());
     }
 
     template<class Writer>
@@ -40,6 +40,7 @@ class transient<Mmapped, T> {
 public:
     typedef transient<Mmapped, T> MmappedType;
     static FormatVersion formatVersion(Versions& vs) { return vs.dependent<T>("transient"); }
+    static bool needsLayout(impl::LayoutDeps&) { return true; }
 
     ~transient()
     {
@@ -59,6 +59,42 @@ Yes hasWriters(
 template<class T>
 No hasWriters(...);
 
+/*
+ * Types which cannot have writeData() and writeField() of their own
+ * (std containers, for example; see mms/std.h) get them from
+ * a specialization of this class, which should define
+ *
+ *   static const bool defined = true;
+ *   template<class Writer> static size_t writeData(Writer&, const T&);
+ *   template<class Writer> static size_t writeField(Writer&, const T&, size_t pos);
+ *
+ * meaning the same as the members would.
+ */
+template<class T>
+struct ExternalWriters {
+    static const bool defined = false;
+};
+
+// Actions wishing to know names of fields (see mms::field()) define
+//   typedef void AcceptsFieldNames;
+// and get them as the second argument (0 for fields with no name).
+template<class Action>
+Yes acceptsFieldNames(typename Action::AcceptsFieldNames*);
+template<class Action>
+No acceptsFieldNames(...);
+
+template<class Action, bool Named = sizeof(acceptsFieldNames<Action>(0)) == sizeof(Yes)>
+struct FieldCall {
+    template<class H>
+    static void call(Action& a, H& h, const char*) { a(h); }
+};
+
+template<class Action>
+struct FieldCall<Action, true> {
+    template<class H>
+    static void call(Action& a, H& h, const char* name) { a(h, name); }
+};
+
 template <class Action>
 class ActionFacade {
 public:
@@ -67,27 +103,27 @@ public:
 #if MMS_USE_CXX11
     template <class H, class... T>
     ActionFacade<Action>& operator()(H &h, T&... ts) {
-        action_(h);
+        FieldCall<Action>::call(action_, h, 0);
         return this->operator()(ts...);
     }
 
     template <class H, class... T>
     ActionFacade<Action>& operator()(
             const FieldDescriptor<H> &desc, T&... ts) {
-        action_(*desc.object);
+        FieldCall<Action>::call(action_, *desc.object, desc.name);
         return this->operator()(ts...);
     }
 #endif
 
     template <class H>
     ActionFacade<Action>& operator()(H &h) {
-        action_(h);
+        FieldCall<Action>::call(action_, h, 0);
         return *this;
     }
 
     template <class H>
     ActionFacade<Action>& operator()(const FieldDescriptor<H>& desc) {
-        action_(*desc.object);
+        FieldCall<Action>::call(action_, *desc.object, desc.name);
         return *this;
     }
 
@@ -200,6 +236,26 @@ struct MmappedTypeAux<std::pair<X, Y>, false>
     > type;
 };
 
+// Values are written with their natural alignment, but at least
+// with that of a pointer, and at most with MAX_ALIGNMENT.
+static const size_t MAX_ALIGNMENT = 64;
+
+template<class TMM>
+inline size_t alignmentOfMmapped()
+{
+#if MMS_USE_CXX11
+    const size_t alignment = alignof(TMM);
+#else
+    const size_t alignment = __alignof__(TMM);
+#endif
+    return alignment < sizeof(void*) ? sizeof(void*)
+        : alignment > MAX_ALIGNMENT ? MAX_ALIGNMENT
+        : alignment;
+}
+
+template<class T>
+inline size_t alignmentOf() { return alignmentOfMmapped<typename MmappedType<T>::type>(); }
+
 /*
  * If you got the "...has no member named 'traverseFields'"
  * error at this point, you forgot to enumerate the fields
@@ -220,4 +276,16 @@ void traverseFields(const T& t, A a) { t.traverseFields(a); }
 
 using impl::MmappedType;
 
+/**
+ * Names a field passed to traverseFields(), for tools reporting
+ * on fields (see mms/residency.h); makes no difference otherwise:
+ *
+ *   a(mms::field("keys", keys))(mms::field("values", values));
+ */
+template<class T>
+inline impl::FieldDescriptor<const T> field(const char* name, const T& object)
+{
+    return impl::makeFieldDescriptor(name, &object);
+}
+
 } //namespace mms
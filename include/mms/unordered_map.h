@@ -74,6 +74,18 @@ public:
 
     typedef unordered_map<Mmapped, K, V, Hash, Eq> MmappedType;
     static FormatVersion formatVersion(Versions& vs) { return vs.dependent<K, V>("unordered_map"); }
+    static bool needsLayout(impl::LayoutDeps& deps) { return deps.dependent<K, V>(); }
+
+    // Defined here rather than inherited, to be seen by impl::hasCollectPointees()
+    template<class Extent>
+    void collectPointees(Extent& e) const { Base::collectPointees(e); }
+
+    // Mmapped hashtables can be written as well (see Hashtable::rewriteData())
+    template<class Writer>
+    size_t writeData(Writer& w) const { return Base::rewriteData(w); }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const { return Base::writeField(w, *this, pos); }
 };
 
 
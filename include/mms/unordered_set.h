@@ -53,6 +53,18 @@ private:
 public:
     typedef unordered_set<Mmapped, T, Hash, Eq> MmappedType;
     static FormatVersion formatVersion(Versions& vs) { return vs.dependent<T>("unordered_set"); }
+    static bool needsLayout(impl::LayoutDeps& deps) { return deps.dependent<T>(); }
+
+    // Defined here rather than inherited, to be seen by impl::hasCollectPointees()
+    template<class Extent>
+    void collectPointees(Extent& e) const { Base::collectPointees(e); }
+
+    // Mmapped hashtables can be written as well (see Hashtable::rewriteData())
+    template<class Writer>
+    size_t writeData(Writer& w) const { return Base::rewriteData(w); }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const { return Base::writeField(w, *this, pos); }
 };
 
 template<class T, template<class> class Hash, template<class> class Eq>
@@ -35,6 +35,7 @@
 #include "impl/tags.h"
 #include "impl/container.h"
 #include "impl/fwd.h"
+#include "impl/rewrite.h"
 
 #include <vector>
 
@@ -49,13 +50,11 @@ template <class T>
 struct WriteSelector<true, T> {
     template <class Writer, class Iterator>
     size_t operator()(Writer& w, Iterator begin, Iterator end) {
-        impl::align(w);
-        size_t res = w.pos();
-
-        w.write(
-                &*begin,
-                (end - begin)*sizeof(
-                    typename std::iterator_traits<Iterator>::value_type));
+        size_t size = (end - begin) * sizeof(
+                typename std::iterator_traits<Iterator>::value_type);
+        size_t res = impl::beginBody(w, size, impl::alignmentOf<T>());
+        w.write(&*begin, size);
+        impl::endBody(w, res);
         return res;
     }
 };
@@ -64,10 +63,22 @@ template <class T>
 struct WriteSelector<false, T> {
     template <class Writer, class Iterator>
     size_t operator()(Writer& w, Iterator begin, Iterator end) {
+        // Structs which look in memory exactly as they should
+        // in the output are written all at once, like trivial types
+        if (impl::hasFlatLayout<T>())
+            return WriteSelector<true, T>()(w, begin, end);
         return impl::writeRange<T>(w, begin, end);
     }
 };
 
+template <>
+struct WriteSelector<false, bool> {
+    template <class Writer, class Iterator>
+    size_t operator()(Writer& w, Iterator begin, Iterator end) {
+        return impl::writeRange<bool>(w, begin, end);
+    }
+};
+
 } // namespace vector_impl
 
 template<class T>
@@ -75,7 +86,28 @@ class vector<Mmapped, T>: public impl::Sequence<T>
 {
 public:
     static FormatVersion formatVersion(Versions& vs) { return vs.dependent<T>("vector"); }
+    static bool needsLayout(impl::LayoutDeps& deps) { return deps.dependent<T>(); }
     typedef vector<Mmapped, T> MmappedType;
+
+    // Mmapped vectors can be written as well, copying
+    // what they refer to in bulk (see impl/rewrite.h)
+    template<class Extent>
+    void collectPointees(Extent& e) const
+    {
+        impl::collectItems(e, this->begin(), this->size());
+    }
+
+    template<class Writer>
+    size_t writeData(Writer& w) const
+    {
+        return impl::rewriteItems(w, this->begin(), this->size());
+    }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const
+    {
+        return impl::writeRef(w, pos, this->size());
+    }
 };
 
 
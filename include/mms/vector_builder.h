@@ -0,0 +1,226 @@
+/*
+ * mms/vector_builder.h -- writing vectors element by element
+ *
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "vector.h"
+#include "writer.h"
+#include "impl/posix.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+namespace mms {
+
+namespace impl {
+
+// Collects a field record of a single element in memory,
+// remembering where offsets are.
+class FieldSpooler: public WriterBase {
+public:
+    void write(const void* data, size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        record_.insert(record_.end(), p, p + size);
+        advance(size);
+    }
+
+    void start()
+    {
+        rewind();
+        record_.clear();
+        slots_.clear();
+    }
+
+    void addSlot(size_t pos) { slots_.push_back(pos); }
+
+    const std::vector<char>& record() const { return record_; }
+    const std::vector<size_t>& slots() const { return slots_; }
+
+private:
+    std::vector<char> record_;
+    std::vector<size_t> slots_;
+};
+
+inline size_t writeOffset(FieldSpooler& w, size_t dataPos)
+{
+    size_t offsetPos = w.pos();
+    w.addSlot(offsetPos);
+    writePod(w, dataPos);
+    return offsetPos;
+}
+
+} // namespace impl
+
+
+/**
+ * A vector written by VectorBuilder. Stands for
+ * mms::vector<Standalone, T> in objects written after it
+ * to the same writer, e.g.:
+ *
+ *   struct DocWriter {
+ *       typedef Doc<mms::Mmapped> MmappedType;
+ *       int id;
+ *       mms::BuiltVector< Item<mms::Standalone> > items;
+ *       template<class A> void traverseFields(A a) const { a(id)(items); }
+ *   };
+ */
+template<class T>
+class BuiltVector {
+public:
+    typedef vector<Mmapped, typename impl::MmappedType<T>::type> MmappedType;
+
+    BuiltVector(): pos_(impl::nullOfs()), size_(0) {}
+    BuiltVector(size_t pos, size_t size): pos_(pos), size_(size) {}
+
+    size_t size() const { return size_; }
+
+    template<class Writer>
+    size_t writeData(Writer&) const { return pos_; }
+
+    template<class Writer>
+    size_t writeField(Writer& w, size_t pos) const { return impl::writeRef(w, pos, size_); }
+
+private:
+    size_t pos_;
+    size_t size_;
+};
+
+
+/**
+ * Writes mms::vector<Mmapped, T> element by element, without
+ * keeping them all in memory. Data of each element is written
+ * immediately; its field record, which is to follow data of all
+ * elements, is spooled to a temporary file. finish() appends
+ * field records and returns a BuiltVector to be written as a field
+ * of an enclosing object (or by itself). Trivial elements have no data,
+ * so their records are spooled as well: the body they make is only
+ * placed (see WriterBase::setBodyAlignment()) once its size is known.
+ *
+ * Nothing else may be written to the writer until finish() is called.
+ * Elements must not need a layout pass (i.e. contain no pointers
+ * or transients), and neither may anything BuiltVector is a part of.
+ */
+template<class T, class Writer = mms::Writer>
+class VectorBuilder {
+public:
+    explicit VectorBuilder(Writer& w): w_(&w), size_(0), spool_(0)
+    {
+        if (impl::needsLayout<T>())
+            throw std::logic_error("mms::VectorBuilder cannot write types requiring layout pass");
+        impl::align(w, impl::alignmentOf<T>());
+        spool_ = tmpfile();
+        if (!spool_)
+            impl::throwSystemError("mms: cannot create a spool file");
+    }
+
+    ~VectorBuilder()
+    {
+        if (spool_)
+            fclose(spool_);
+    }
+
+    void push_back(const T& t)
+    {
+        if (!spool_)
+            throw std::logic_error("mms::VectorBuilder::push_back() called after finish()");
+        impl::OffsetsFrame ofs(*w_);
+        impl::writeData(*w_, t, ofs.populate());
+        spooler_.start();
+        impl::writeField(spooler_, t, ofs.consume());
+
+        const std::vector<char>& rec = spooler_.record();
+        if (!size_)
+            slots_ = spooler_.slots();
+        else if (spooler_.slots() != slots_ || rec.size() != RecordSize)
+            throw std::logic_error("mms::VectorBuilder: field records differ in layout");
+        if (fwrite(&rec[0], rec.size(), 1, spool_) != 1)
+            impl::throwSystemError("mms: cannot write to a spool file");
+        ++size_;
+    }
+
+    size_t size() const { return size_; }
+
+    BuiltVector<T> finish()
+    {
+        if (!spool_)
+            throw std::logic_error("mms::VectorBuilder::finish() called twice");
+
+        size_t fieldsPos = impl::beginBody(*w_, size_ * RecordSize, impl::alignmentOf<T>());
+        if (fflush(spool_) != 0 || fseek(spool_, 0, SEEK_SET) != 0)
+            impl::throwSystemError("mms: cannot rewind a spool file");
+
+        const size_t batch = std::max<size_t>(1, BUFFER_SIZE / RecordSize);
+        std::vector<char> buf(std::min(batch, size_) * RecordSize);
+        for (size_t first = 0; first < size_; first += batch) {
+            size_t n = std::min(batch, size_ - first);
+            if (fread(&buf[0], RecordSize, n, spool_) != n)
+                impl::throwSystemError("mms: cannot read from a spool file");
+            for (size_t i = 0; i != n; ++i) {
+                size_t recordPos = fieldsPos + (first + i) * RecordSize;
+                for (size_t s = 0; s != slots_.size(); ++s)
+                    patch(&buf[i * RecordSize + slots_[s]], recordPos + slots_[s]);
+            }
+            w_->write(&buf[0], n * RecordSize);
+        }
+
+        impl::endBody(*w_, fieldsPos);
+
+        fclose(spool_);
+        spool_ = 0;
+        return BuiltVector<T>(fieldsPos, size_);
+    }
+
+private:
+    static const size_t RecordSize = sizeof(typename impl::MmappedType<T>::type);
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    Writer* w_;
+    size_t size_;
+    FILE* spool_;
+    impl::FieldSpooler spooler_;
+    std::vector<size_t> slots_;
+
+    // Turns an absolute position stored by FieldSpooler
+    // into an offset relative to `offsetPos'.
+    static void patch(char* slot, size_t offsetPos)
+    {
+        size_t dataPos;
+        memcpy(&dataPos, slot, sizeof(dataPos));
+        size_t ofs = (dataPos != impl::nullOfs()) ? (dataPos - offsetPos) : 0;
+        memcpy(slot, &ofs, sizeof(ofs));
+    }
+
+    VectorBuilder(const VectorBuilder&);
+    VectorBuilder& operator = (const VectorBuilder&);
+};
+
+} // namespace mms
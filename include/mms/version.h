@@ -120,6 +120,18 @@ FormatVersion formatVersion()
     return vs.get<T>();
 }
 
+// Earlier versions of mms aligned everything to sizeof(void*) at most,
+// so data of over-aligned types gets a different version, rejected by
+// their readers. Versions of all other types stay the same.
+template<class TMM>
+inline FormatVersion withAlignment(Versions& vs, FormatVersion version)
+{
+    size_t alignment = alignmentOfMmapped<TMM>();
+    return alignment > sizeof(void*)
+        ? vs.combine(version, vs.hash("alignment"), alignment)
+        : version;
+}
+
 // Case 0. Classes having a 'static FormatVersion enforceVersion(Versions&)'.
 //         Just invoke the function and return its result untouched.
 template<class TMM, bool HasFormatVersionEx, bool HasFormatVersion, bool HasTraverseFields>
@@ -180,7 +192,8 @@ struct FormatVersionHelper<TMM, false, false, false, true> {
         FormatVersion version = 0;
         traverseFields(*tmm, ActionFacade<FormatVersionCalculator>(
             FormatVersionCalculator(vs, version)));
-        return vs.combine(version, FormatVersionHelper<TMM, false, false, false, false>::version(vs));
+        return withAlignment<TMM>(vs,
+            vs.combine(version, FormatVersionHelper<TMM, false, false, false, false>::version(vs)));
     }
 };
 
@@ -191,7 +204,7 @@ struct FormatVersionHelper<TMM, false, false, false, false> {
     static FormatVersion version(Versions& vs)
     {
         if (mms::type_traits::is_trivial<TMM>::value) {
-            return vs.combine(vs.hash(typeid(TMM).name()), sizeof(TMM));
+            return withAlignment<TMM>(vs, vs.combine(vs.hash(typeid(TMM).name()), sizeof(TMM)));
         } else {
             return 0; // FIXME: better fail here, but will break existing data
         }
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "impl/defs.h"
+#include "type_traits.h"
 #include <iostream>
 
 namespace mms {
@@ -47,9 +48,21 @@ private:
     std::ostream* out_;
 };
 
-/// Writes element (with its format version) to a stream.
-template< class T >
-size_t safeWrite(Writer& w, const T& t);
+namespace impl {
+
+// Enables write functions for any class derived from WriterBase
+// (mms::Writer, mms::FdWriter, etc.), while leaving std::ostream
+// overloads alone.
+template<class W, class R>
+struct EnableIfWriter: public mms::type_traits::enable_if<
+    mms::type_traits::is_base_of<WriterBase, W>::value, R
+> {};
+
+} // namespace impl
+
+/// Writes element (with its format version) to a writer.
+template<class W, class T>
+typename impl::EnableIfWriter<W, size_t>::type safeWrite(W& w, const T& t);
 
 /// Same as above. Returned position will be relative
 /// to current stream position.
@@ -58,7 +71,8 @@ size_t safeWrite(std::ostream& out, const T& t);
 
 
 /// Aliases to safeWrite()
-template<class T> size_t write(Writer& w, const T& t)
+template<class W, class T>
+typename impl::EnableIfWriter<W, size_t>::type write(W& w, const T& t)
     { return safeWrite(w, t); }
 
 template<class T> size_t write(std::ostream& out, const T& t)
@@ -67,12 +81,24 @@ template<class T> size_t write(std::ostream& out, const T& t)
 
 /// Writes element without its version, thus making
 /// safeCast() inappropriate.
-template< class T >
-size_t unsafeWrite(Writer& w, const T& t);
+template<class W, class T>
+typename impl::EnableIfWriter<W, size_t>::type unsafeWrite(W& w, const T& t);
 
 template< class T >
 size_t unsafeWrite(std::ostream& out, const T& t);
 
+
+/// Returns number of bytes safeWrite() would produce, without
+/// writing anything.
+template<class T> size_t safeSerializedSize(const T& t);
+
+/// Same for unsafeWrite().
+template<class T> size_t unsafeSerializedSize(const T& t);
+
+/// Alias to safeSerializedSize()
+template<class T> size_t serializedSize(const T& t)
+    { return safeSerializedSize(t); }
+
 }//namespace mms
 
 #define MMS_WRITER_IMPL_H
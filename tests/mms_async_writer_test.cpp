@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include "tools.h"
+
+#include <sstream>
+#include <cstdio>
+
+#if MMS_USE_CXX11
+
+#include <mms/async_writer.h>
+
+#include <fcntl.h>
+
+namespace {
+
+void checkAsyncWriter(bool direct)
+{
+    size_t bufferSizes[] = { 1, 4096, 3 * 4096, mms::AsyncFdWriter::DEFAULT_BUFFER_SIZE };
+    size_t bufferCounts[] = { 2, 3 };
+    size_t bodySizes[] = { 0, 10, 1000, 100000 };
+
+    for (size_t b = 0; b != sizeof(bufferSizes) / sizeof(*bufferSizes); ++b) {
+        for (size_t c = 0; c != sizeof(bufferCounts) / sizeof(*bufferCounts); ++c) {
+            for (size_t s = 0; s != sizeof(bodySizes) / sizeof(*bodySizes); ++s) {
+                Doc<mms::Standalone> doc = genDoc(bodySizes[s]);
+
+                std::stringstream expected;
+                size_t expectedPos = mms::safeWrite(expected, doc);
+
+                FILE* f = tmpfile();
+                BOOST_REQUIRE(f);
+                size_t pos;
+                mms::AsyncFdWriter::Stats stats;
+                {
+                    mms::AsyncFdWriter w(fileno(f), bufferSizes[b], bufferCounts[c], direct);
+                    pos = mms::safeWrite(w, doc);
+                    w.flush();
+                    BOOST_CHECK_EQUAL(w.pos(), expected.str().size());
+                    BOOST_CHECK_EQUAL(lseek(fileno(f), 0, SEEK_CUR), (off_t) w.pos());
+                    stats = w.stats();
+                }
+                std::string actual = readAll(fileno(f));
+                fclose(f);
+
+                BOOST_CHECK_EQUAL(pos, expectedPos);
+                BOOST_CHECK(actual == expected.str());
+                BOOST_CHECK(stats.flushes > 0);
+                BOOST_CHECK_EQUAL(stats.bytesFlushed, actual.size());
+                BOOST_CHECK(stats.maxFlushSeconds <= stats.flushSeconds);
+
+                const Doc<mms::Mmapped>& mm =
+                    mms::safeCast< Doc<mms::Mmapped> >(actual.data(), actual.size());
+                BOOST_CHECK_EQUAL(mm.id, 17);
+                BOOST_CHECK_EQUAL(mm.body.size(), bodySizes[s]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( async_writer )
+{
+    checkAsyncWriter(false);
+}
+
+BOOST_AUTO_TEST_CASE( async_writer_direct )
+{
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f);
+    int flags = fcntl(fileno(f), F_GETFL);
+    bool supported = fcntl(fileno(f), F_SETFL, flags | O_DIRECT) == 0;
+    fclose(f);
+
+    if (supported)
+        checkAsyncWriter(true);
+    else
+        BOOST_TEST_MESSAGE("O_DIRECT is not supported for temporary files, skipping");
+}
+
+BOOST_AUTO_TEST_CASE( async_writer_repeated_flush )
+{
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f);
+    mms::AsyncFdWriter w(fileno(f), 4096);
+    std::string expected;
+    for (size_t i = 0; i != 100; ++i) {
+        std::string s(i * 37, 'a' + i % 26);
+        w.write(s.data(), s.size());
+        expected += s;
+        if (i % 7 == 0) {
+            w.flush();
+            BOOST_CHECK(readAll(fileno(f)) == expected);
+        }
+    }
+    w.flush();
+    BOOST_CHECK(readAll(fileno(f)) == expected);
+    fclose(f);
+}
+
+BOOST_AUTO_TEST_CASE( async_writer_error_sticks )
+{
+    char name[] = "/tmp/mms_test.XXXXXX";
+    int tmp = mkstemp(name);
+    BOOST_REQUIRE(tmp >= 0);
+    close(tmp);
+    // Writes to a read-only descriptor fail with EBADF
+    int fd = open(name, O_RDONLY);
+    unlink(name);
+    BOOST_REQUIRE(fd >= 0);
+    {
+        mms::AsyncFdWriter w(fd, 4096);
+        std::string s(10000, 'x');
+        BOOST_CHECK_THROW({ w.write(s.data(), s.size()); w.flush(); }, std::runtime_error);
+        // The data is lost, so nothing may succeed from now on
+        BOOST_CHECK_THROW(w.flush(), std::runtime_error);
+        BOOST_CHECK_THROW(w.write(s.data(), s.size()), std::runtime_error);
+        BOOST_CHECK_THROW(w.flush(), std::runtime_error);
+        BOOST_CHECK_EQUAL(w.stats().bytesFlushed, 0u);
+    }
+    close(fd);
+}
+
+BOOST_AUTO_TEST_CASE( async_writer_error )
+{
+    int fd = open("/dev/full", O_WRONLY);
+    if (fd < 0)
+        return;
+    {
+        mms::AsyncFdWriter w(fd, 4096);
+        std::string s(100000, 'x');
+        BOOST_CHECK_THROW({ w.write(s.data(), s.size()); w.flush(); }, std::runtime_error);
+    }
+    close(fd);
+}
+
+#endif // MMS_USE_CXX11
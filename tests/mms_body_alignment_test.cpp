@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/unordered_map.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Tables {
+    mms::string<P> title;
+    mms::vector<P, int> small;
+    mms::vector<P, int> large;
+    mms::map<P, int, mms::string<P> > names;
+    mms::unordered_map<P, int, int> lookup;
+
+    template<class A> void traverseFields(A a) const { a(title)(small)(large)(names)(lookup); }
+};
+
+Tables<mms::Standalone> genTables(size_t size)
+{
+    Tables<mms::Standalone> t;
+    t.title = "tables";
+    t.small.assign(10, 1);
+    for (size_t i = 0; i != size; ++i) {
+        t.large.push_back(i);
+        std::ostringstream s;
+        s << "name #" << i;
+        t.names[i] = s.str();
+        t.lookup[i] = i * 3;
+    }
+    return t;
+}
+
+void checkTables(const Tables<mms::Mmapped>& t, size_t size)
+{
+    BOOST_CHECK_EQUAL(t.title, "tables");
+    BOOST_CHECK_EQUAL(t.small.size(), 10u);
+    BOOST_REQUIRE_EQUAL(t.large.size(), size);
+    BOOST_REQUIRE_EQUAL(t.names.size(), size);
+    BOOST_REQUIRE_EQUAL(t.lookup.size(), size);
+    for (size_t i = 0; i != size; ++i) {
+        BOOST_CHECK_EQUAL(t.large[i], (int) i);
+        BOOST_CHECK_EQUAL(t.lookup.find(i)->second, (int) i * 3);
+    }
+    std::ostringstream name;
+    name << "name #" << size / 2;
+    BOOST_CHECK_EQUAL(t.names.find(size / 2)->second, name.str());
+}
+
+void checkExtents(const mms::impl::Extents& extents, size_t alignment, size_t threshold)
+{
+    for (size_t i = 0; i != extents.size(); ++i) {
+        BOOST_CHECK_EQUAL(extents[i].pos % alignment, 0u);
+        BOOST_CHECK(extents[i].size >= threshold);
+        if (i)
+            BOOST_CHECK(extents[i - 1].pos + extents[i - 1].size <= extents[i].pos);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( body_alignment )
+{
+    const size_t size = 5000;
+    Tables<mms::Standalone> t = genTables(size);
+
+    mms::BufferWriter plain;
+    mms::safeWrite(plain, t);
+    BOOST_CHECK(plain.bodyExtents().empty());
+
+    size_t alignments[] = { 4096, 2 << 20 };
+    for (size_t a = 0; a != 2; ++a) {
+        mms::BufferWriter w;
+        w.setBodyAlignment(4096, alignments[a]);
+        mms::safeWrite(w, t);
+
+        const Tables<mms::Mmapped>& mm = w.safeCast< Tables<mms::Mmapped> >();
+        checkTables(mm, size);
+
+        const mms::impl::Extents& extents = w.bodyExtents();
+        // large, fields of names, fields and buckets of lookup
+        BOOST_REQUIRE_EQUAL(extents.size(), 4u);
+        checkExtents(extents, alignments[a], 4096);
+
+        const char* base = w.data();
+        BOOST_CHECK_EQUAL(reinterpret_cast<const char*>(&mm.large[0]) - base, (ptrdiff_t) extents[0].pos);
+        BOOST_CHECK_EQUAL(extents[0].size, size * sizeof(int));
+        BOOST_CHECK_EQUAL(reinterpret_cast<const char*>(&*mm.names.begin()) - base, (ptrdiff_t) extents[1].pos);
+        BOOST_CHECK_EQUAL(extents[1].size, mm.names.size() * sizeof(*mm.names.begin()));
+
+        // Nothing else shares pages with the bodies
+        BOOST_CHECK(reinterpret_cast<const char*>(&mm.small[0]) < base + extents[0].pos
+            || reinterpret_cast<const char*>(&mm.small[0]) >= base + extents[3].pos + extents[3].size);
+        BOOST_CHECK(w.size() >= extents[3].pos + alignments[a]);
+
+        w.clear();
+        BOOST_CHECK(w.bodyExtents().empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( body_alignment_threshold )
+{
+    Tables<mms::Standalone> t = genTables(100);
+
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setBodyAlignment(1000);
+    mms::safeWrite(w, t);
+
+    // Vectors are too small; fields of the map (100 * 24 bytes) are not.
+    // Whether buckets of the hashtable are depends on their number.
+    BOOST_REQUIRE(!w.bodyExtents().empty());
+    checkExtents(w.bodyExtents(), 4096, 1000);
+
+    std::string buf = out.str();
+    const Tables<mms::Mmapped>& mm = mms::safeCast< Tables<mms::Mmapped> >(buf.data(), buf.size());
+    checkTables(mm, 100);
+    BOOST_CHECK_EQUAL(
+        reinterpret_cast<const char*>(&*mm.names.begin()) - buf.data(),
+        (ptrdiff_t) w.bodyExtents()[0].pos);
+
+    BOOST_CHECK_THROW(w.setBodyAlignment(1000, 4095), std::invalid_argument);
+    BOOST_CHECK_THROW(w.setBodyAlignment(1000, 4), std::invalid_argument);
+    w.setBodyAlignment(0);
+    BOOST_CHECK_EQUAL(w.bodyAlignment(), 0u);
+}
+
+#if MMS_USE_CXX11
+BOOST_AUTO_TEST_CASE( body_alignment_parallel )
+{
+    mms::vector< mms::Standalone, Tables<mms::Standalone> > v(20, genTables(300));
+
+    std::ostringstream expected;
+    mms::Writer sequential(expected);
+    sequential.setBodyAlignment(100);
+    mms::safeWrite(sequential, v);
+
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setBodyAlignment(100);
+    w.setThreads(3, 2);
+    mms::safeWrite(w, v);
+
+    // Containers nested in chunks are not aligned, but the outermost is
+    BOOST_CHECK(out.str().size() < expected.str().size());
+    BOOST_REQUIRE_EQUAL(w.bodyExtents().size(), 1u);
+    checkExtents(w.bodyExtents(), 4096, 100);
+
+    std::string buf = out.str();
+    const mms::vector< mms::Mmapped, Tables<mms::Mmapped> >& mm =
+        mms::safeCast< mms::vector< mms::Mmapped, Tables<mms::Mmapped> > >(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), 20u);
+    BOOST_CHECK_EQUAL((reinterpret_cast<const char*>(&mm[0]) - buf.data()) % 4096, 0);
+    for (size_t i = 0; i != mm.size(); ++i)
+        checkTables(mm[i], 300);
+}
+#endif
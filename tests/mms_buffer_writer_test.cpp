@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+
+#include <mms/buffer_writer.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/ptr.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Entry {
+    int key;
+    mms::string<P> value;
+    mms::vector<P, int> refs;
+
+    template<class A> void traverseFields(A a) const { a(key)(value)(refs); }
+};
+
+typedef mms::vector< mms::Standalone, Entry<mms::Standalone> > Entries;
+typedef mms::vector< mms::Mmapped, Entry<mms::Mmapped> > MmappedEntries;
+
+Entries genEntries(size_t count)
+{
+    Entries e(count);
+    for (size_t i = 0; i != count; ++i) {
+        e[i].key = i;
+        e[i].value = std::string(i % 13, 'a' + i % 26);
+        e[i].refs.assign(i % 7, i);
+    }
+    return e;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( buffer_writer )
+{
+    Entries e = genEntries(1000);
+
+    std::stringstream expected;
+    mms::safeWrite(expected, e);
+
+    mms::BufferWriter w;
+    mms::safeWrite(w, e);
+    BOOST_CHECK_EQUAL(w.size(), expected.str().size());
+    BOOST_CHECK(std::string(w.data(), w.size()) == expected.str());
+    BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(w.data()) % mms::BufferWriter::ALIGNMENT, 0);
+
+    const MmappedEntries& mm = w.safeCast<MmappedEntries>();
+    BOOST_REQUIRE_EQUAL(mm.size(), 1000);
+    BOOST_CHECK_EQUAL(mm[100].key, 100);
+    BOOST_CHECK_EQUAL(mm[100].value, std::string(9, 'w'));
+    BOOST_CHECK_EQUAL(mm[100].refs.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( buffer_writer_reuse )
+{
+    Entries e = genEntries(500);
+
+    mms::BufferWriter w;
+    mms::safeWrite(w, e);
+    std::string first(w.data(), w.size());
+    const char* data = w.data();
+    size_t capacity = w.capacity();
+
+    for (int i = 0; i != 10; ++i) {
+        w.clear();
+        BOOST_CHECK_EQUAL(w.size(), 0);
+        mms::safeWrite(w, e);
+        BOOST_CHECK(w.data() == data);
+        BOOST_CHECK_EQUAL(w.capacity(), capacity);
+        BOOST_CHECK(std::string(w.data(), w.size()) == first);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( buffer_writer_presize )
+{
+    typedef mms::shared_ptr< mms::Standalone, OuterPtr<mms::Standalone> > Ptr;
+    typedef mms::shared_ptr< mms::Mmapped, OuterPtr<mms::Mmapped> > MmappedPtr;
+    Ptr p(new OuterPtr<mms::Standalone>(100));
+
+    // Layout pass tells the exact size, so there should be
+    // a single allocation of just enough pages.
+    mms::BufferWriter w;
+    mms::safeWrite(w, p);
+    const size_t page = mms::BufferWriter::ALIGNMENT;
+    BOOST_CHECK_EQUAL(w.capacity(), (w.size() + page - 1) / page * page);
+
+    for (int i = 0; i != 2; ++i) {
+        // Pointees must be written again after clear()
+        const MmappedPtr& mm = w.safeCast<MmappedPtr>();
+        BOOST_REQUIRE_EQUAL(mm->inners.size(), 100);
+        BOOST_CHECK_EQUAL(mm->inners[42]->x, 42);
+        BOOST_CHECK(mm->inners[42]->outer.get() == mm.get());
+
+        w.clear();
+        mms::safeWrite(w, p);
+    }
+}
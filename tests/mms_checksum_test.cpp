@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/checksum.h>
+#include <mms/buffer_writer.h>
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include "tools.h"
+
+#include <sstream>
+#include <cstdlib>
+
+namespace {
+
+std::string checksummed(const Doc<mms::Standalone>& doc, size_t blockSize)
+{
+    std::ostringstream out;
+    mms::Writer w(out);
+    mms::ChecksumWriter<mms::Writer> cw(w, blockSize);
+    mms::safeWrite(cw, doc);
+    cw.finish();
+    return out.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( crc32c_values )
+{
+    BOOST_CHECK_EQUAL(mms::impl::crc32c(0, "123456789", 9), 0xe3069283u);
+    BOOST_CHECK_EQUAL(mms::impl::crc32c(0, "", 0), 0u);
+    BOOST_CHECK_EQUAL(
+        mms::impl::crc32c(mms::impl::crc32c(0, "1234", 4), "56789", 5),
+        0xe3069283u);
+
+    std::string data(10000, '\0');
+    for (size_t i = 0; i != data.size(); ++i)
+        data[i] = static_cast<char>(rand());
+    for (size_t start = 0; start != 9; ++start) {
+        for (size_t size = 0; size < 200; size += 7) {
+            const char* p = data.data() + start;
+            uint32_t sw = ~mms::impl::crc32cSoftware(~0u, p, size);
+            uint32_t bytewise = 0xffffffffu;
+            for (size_t i = 0; i != size; ++i) {
+                bytewise ^= static_cast<unsigned char>(p[i]);
+                for (int k = 0; k != 8; ++k)
+                    bytewise = (bytewise >> 1) ^ (0x82f63b78u & (0 - (bytewise & 1)));
+            }
+            BOOST_CHECK_EQUAL(sw, ~bytewise);
+            BOOST_CHECK_EQUAL(mms::impl::crc32c(0, p, size), sw);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( checksummed_write )
+{
+    size_t blockSizes[] = { 1, 100, 4096, mms::ChecksumWriter<mms::Writer>::DEFAULT_BLOCK_SIZE };
+    size_t bodySizes[] = { 0, 1000, 100000 };
+
+    for (size_t b = 0; b != sizeof(blockSizes) / sizeof(*blockSizes); ++b) {
+        for (size_t s = 0; s != sizeof(bodySizes) / sizeof(*bodySizes); ++s) {
+            Doc<mms::Standalone> doc = genDoc(bodySizes[s]);
+            std::ostringstream plain;
+            mms::safeWrite(plain, doc);
+
+            std::string buf = checksummed(doc, blockSizes[b]);
+            mms::Checksums c(buf.data(), buf.size());
+            BOOST_CHECK_EQUAL(c.dataSize(), plain.str().size());
+            BOOST_CHECK(std::string(c.data(), c.dataSize()) == plain.str());
+            BOOST_CHECK_EQUAL(c.blockCount(), (c.dataSize() + blockSizes[b] - 1) / blockSizes[b]);
+
+            for (size_t threads = 1; threads != 4; ++threads) {
+                const Doc<mms::Mmapped>& mm =
+                    mms::checkedCast< Doc<mms::Mmapped> >(buf.data(), buf.size(), threads);
+                BOOST_CHECK_EQUAL(mm.id, 17);
+                BOOST_CHECK_EQUAL(mm.body.size(), bodySizes[s]);
+            }
+        }
+    }
+
+    Doc<mms::Standalone> doc = genDoc(1000);
+    std::ostringstream out;
+    mms::checksummedWrite(out, doc);
+    BOOST_CHECK_EQUAL(
+        mms::checkedCast< Doc<mms::Mmapped> >(out.str().data(), out.str().size()).title,
+        doc.title);
+
+    mms::BufferWriter w;
+    mms::checksummedWrite(w, doc);
+    BOOST_CHECK_EQUAL(mms::checkedCast< Doc<mms::Mmapped> >(w.data(), w.size()).id, 17);
+}
+
+BOOST_AUTO_TEST_CASE( checksummed_write_after_data )
+{
+    Doc<mms::Standalone> doc = genDoc(100000);
+    mms::BufferWriter w;
+    w.write("abc", 3);
+    w.setBodyAlignment(1000);
+    size_t pos = mms::checksummedWrite(w, doc);
+
+    const char* data = w.data() + 3;
+    const Doc<mms::Mmapped>& mm = mms::checkedCast< Doc<mms::Mmapped> >(data, w.size() - 3);
+    BOOST_CHECK_EQUAL(reinterpret_cast<const char*>(&mm) - data, (ptrdiff_t) pos);
+    BOOST_CHECK_EQUAL(mm.body.size(), 100000u);
+
+    // Bodies are aligned within the whole output, as are their extents
+    BOOST_REQUIRE(!w.bodyExtents().empty());
+    BOOST_CHECK_EQUAL((reinterpret_cast<const char*>(mm.body.begin()) - w.data()) % 4096, 0);
+    for (mms::impl::Extents::const_iterator i = w.bodyExtents().begin(), ie = w.bodyExtents().end(); i != ie; ++i)
+        BOOST_CHECK_EQUAL(i->pos % 4096, 0u);
+}
+
+BOOST_AUTO_TEST_CASE( checksum_detects_corruption )
+{
+    std::string good = checksummed(genDoc(10000), 1000);
+    size_t dataSize = mms::Checksums(good.data(), good.size()).dataSize();
+
+    // Flip a bit in data
+    for (size_t pos = 0; pos < dataSize; pos += 997) {
+        std::string bad = good;
+        bad[pos] ^= 0x10;
+        mms::Checksums c(bad.data(), bad.size());
+        BOOST_CHECK(!c.checkBlock(pos / 1000));
+        BOOST_CHECK(pos < 1000 || c.checkBlock(0));
+        BOOST_CHECK_THROW(c.verify(1), std::runtime_error);
+        BOOST_CHECK_THROW(c.verify(3), std::runtime_error);
+        BOOST_CHECK_THROW(c.verifyRange(pos, 1), std::runtime_error);
+        BOOST_CHECK_THROW(
+            (mms::checkedCast< Doc<mms::Mmapped> >(bad.data(), bad.size())),
+            std::runtime_error);
+    }
+
+    // ...in the table or the trailer
+    for (size_t pos = dataSize; pos != good.size(); ++pos) {
+        std::string bad = good;
+        bad[pos] ^= 0x01;
+        BOOST_CHECK_THROW(mms::Checksums(bad.data(), bad.size()), std::runtime_error);
+    }
+
+    // Truncated
+    BOOST_CHECK_THROW(mms::Checksums(good.data(), good.size() - 1), std::runtime_error);
+    BOOST_CHECK_THROW(mms::Checksums(good.data(), 10), std::length_error);
+
+    // Not checksummed at all
+    std::ostringstream plain;
+    mms::safeWrite(plain, genDoc(10));
+    BOOST_CHECK_THROW(
+        mms::Checksums(plain.str().data(), plain.str().size()),
+        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( checksum_lazy_verification )
+{
+    std::string buf = checksummed(genDoc(100000), 4096);
+    mms::Checksums c(buf.data(), buf.size());
+
+    // Corruption far from the root goes unnoticed until its block is checked
+    buf[10] ^= 0x20;
+    const Doc<mms::Mmapped>& mm = c.safeCast< Doc<mms::Mmapped> >();
+    BOOST_CHECK_EQUAL(mm.id, 17);
+    BOOST_CHECK_THROW(c.verifyRange(0, 4096), std::runtime_error);
+    BOOST_CHECK_NO_THROW(c.verifyRange(4096, c.dataSize() - 4096));
+
+    size_t rootBlock = (c.dataSize() - 1) / 4096;
+    buf[c.dataSize() - 1] ^= 0x20;
+    BOOST_CHECK(!c.checkBlock(rootBlock));
+    BOOST_CHECK_THROW(c.safeCast< Doc<mms::Mmapped> >(), std::runtime_error);
+}
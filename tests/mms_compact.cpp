@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/*
+ * mms_compact -- compacts a file written with mms::write().
+ *
+ * The type of the root must be known in advance; a few common ones
+ * are listed below. Applications with their own types are expected
+ * to call mms::compactFile() with them in the very same way.
+ */
+
+#include <mms/compact.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <iostream>
+#include <string>
+#include <cstring>
+
+namespace {
+
+typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > Strings;
+typedef mms::vector< mms::Mmapped, mms::vector<mms::Mmapped, int> > IntVectors;
+typedef mms::map< mms::Mmapped, mms::string<mms::Mmapped>, mms::string<mms::Mmapped> > StringMap;
+typedef mms::map< mms::Mmapped, mms::string<mms::Mmapped>, mms::vector<mms::Mmapped, int> > StringToInts;
+
+struct RootType {
+    const char* name;
+    mms::CompactStats (*compact)(const std::string&, const std::string&, mms::CompactOrder, bool);
+};
+
+const RootType ROOT_TYPES[] = {
+    { "strings",        &mms::compactFile<Strings> },
+    { "int-vectors",    &mms::compactFile<IntVectors> },
+    { "string-map",     &mms::compactFile<StringMap> },
+    { "string-to-ints", &mms::compactFile<StringToInts> },
+};
+
+const size_t ROOT_TYPE_COUNT = sizeof(ROOT_TYPES) / sizeof(ROOT_TYPES[0]);
+
+int usage(const char* argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [--bfs] [--intern] <type> <input> <output>\n"
+              << "  --bfs     place containers breadth-first (default: depth-first)\n"
+              << "  --intern  write equal strings only once\n"
+              << "<output> is replaced atomically and may be the same file as <input>.\n"
+              << "Types:";
+    for (size_t i = 0; i != ROOT_TYPE_COUNT; ++i)
+        std::cerr << " " << ROOT_TYPES[i].name;
+    std::cerr << std::endl;
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    mms::CompactOrder order = mms::DepthFirst;
+    bool intern = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (!strcmp(argv[arg], "--bfs"))
+            order = mms::BreadthFirst;
+        else if (!strcmp(argv[arg], "--intern"))
+            intern = true;
+        else
+            return usage(argv[0]);
+    }
+    if (argc - arg != 3)
+        return usage(argv[0]);
+
+    const RootType* type = 0;
+    for (size_t i = 0; i != ROOT_TYPE_COUNT; ++i)
+        if (!strcmp(argv[arg], ROOT_TYPES[i].name))
+            type = &ROOT_TYPES[i];
+    if (!type)
+        return usage(argv[0]);
+
+    try {
+        mms::CompactStats stats = type->compact(argv[arg + 1], argv[arg + 2], order, intern);
+        std::cout << "old size:        " << stats.oldSize << " bytes\n"
+                  << "new size:        " << stats.newSize << " bytes\n"
+                  << "bytes reclaimed: " << stats.bytesReclaimed() << "\n"
+                  << "pages saved:     " << stats.pagesSaved() << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
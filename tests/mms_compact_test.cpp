@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/compact.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/unordered_map.h>
+#include <mms/unordered_set.h>
+
+#include "record_index.h"
+
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <unistd.h>
+
+namespace {
+
+void checkIndex(const Index<mms::Mmapped>& idx, size_t size)
+{
+    BOOST_CHECK_EQUAL(idx.title, "index");
+    BOOST_REQUIRE_EQUAL(idx.records.size(), size);
+    BOOST_CHECK_EQUAL(idx.byName.size(), std::min<size_t>(size, 10));
+    for (size_t i = 0; i != size; ++i) {
+        const Record<mms::Mmapped>& r = idx.records[i];
+        BOOST_CHECK_EQUAL(r.id, (int) i);
+        BOOST_REQUIRE_EQUAL(r.values.size(), i % 3);
+        for (size_t j = 0; j != r.values.size(); ++j) {
+            BOOST_REQUIRE_EQUAL(r.values[j].size(), j + 1);
+            BOOST_CHECK_EQUAL(r.values[j][j], (int) i);
+        }
+        BOOST_CHECK_EQUAL(r.tags.size(), i % 3);
+    }
+    BOOST_CHECK_EQUAL(idx.byId.size(), size);
+    BOOST_CHECK_EQUAL(idx.chars.size(), size);
+    BOOST_CHECK_EQUAL(idx.byName["record #3"], (int) (size - 7));
+}
+
+// Writes `idx' after some garbage, with bodies padded to pages
+void writeFragmented(mms::BufferWriter& w, const Index<mms::Standalone>& idx)
+{
+    mms::vector<mms::Standalone, int> garbage(100000, 42);
+    mms::write(w, garbage);
+    w.setBodyAlignment(1024);
+    mms::write(w, idx);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( compact_depth_first )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+    mms::BufferWriter old;
+    writeFragmented(old, src);
+    const Index<mms::Mmapped>& idx = old.safeCast< Index<mms::Mmapped> >();
+
+    mms::BufferWriter w;
+    mms::compact(w, idx);
+    BOOST_CHECK(w.size() < old.size() / 2);
+    checkIndex(w.safeCast< Index<mms::Mmapped> >(), 1000);
+
+    // Same as written from scratch
+    mms::BufferWriter fresh;
+    mms::write(fresh, src);
+    BOOST_CHECK_EQUAL(fresh.size(), w.size());
+    BOOST_CHECK(std::string(fresh.data(), fresh.size()) == std::string(w.data(), w.size()));
+}
+
+BOOST_AUTO_TEST_CASE( compact_breadth_first )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+    mms::BufferWriter old;
+    writeFragmented(old, src);
+
+    mms::BufferWriter w;
+    mms::compact(w, old.safeCast< Index<mms::Mmapped> >(), mms::BreadthFirst);
+    const Index<mms::Mmapped>& idx = w.safeCast< Index<mms::Mmapped> >();
+    checkIndex(idx, 1000);
+
+    // All vectors of ints precede all vectors of them,
+    // which precede the records
+    const char* lastInts = 0;
+    const char* firstValues = w.data() + w.size();
+    for (size_t i = 0; i != idx.records.size(); ++i) {
+        const Record<mms::Mmapped>& r = idx.records[i];
+        if (r.values.empty())
+            continue;
+        firstValues = std::min(firstValues, reinterpret_cast<const char*>(r.values.begin()));
+        for (size_t j = 0; j != r.values.size(); ++j)
+            lastInts = std::max(lastInts, reinterpret_cast<const char*>(r.values[j].end()));
+    }
+    BOOST_CHECK(lastInts <= firstValues);
+    BOOST_CHECK(firstValues < reinterpret_cast<const char*>(idx.records.begin()));
+}
+
+BOOST_AUTO_TEST_CASE( compact_file )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+    mms::BufferWriter old;
+    writeFragmented(old, src);
+
+    char from[] = "/tmp/mms_compact_test.XXXXXX";
+    int fd = mkstemp(from);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE_EQUAL(write(fd, old.data(), old.size()), (ssize_t) old.size());
+    close(fd);
+    std::string to = std::string(from) + ".compact";
+
+    mms::CompactStats stats = mms::compactFile< Index<mms::Mmapped> >(from, to, mms::DepthFirst, true);
+    BOOST_CHECK_EQUAL(stats.oldSize, old.size());
+    BOOST_CHECK(stats.bytesReclaimed() > old.size() / 2);
+    BOOST_CHECK(stats.pagesSaved() > 0);
+
+    mms::FileMapping result(to);
+    BOOST_CHECK_EQUAL(result.size(), stats.newSize);
+    checkIndex(mms::safeCast< Index<mms::Mmapped> >(result.data(), result.size()), 1000);
+
+    unlink(from);
+    unlink(to.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( compact_file_in_place )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+    mms::BufferWriter old;
+    writeFragmented(old, src);
+
+    char path[] = "/tmp/mms_compact_test.XXXXXX";
+    int fd = mkstemp(path);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE_EQUAL(write(fd, old.data(), old.size()), (ssize_t) old.size());
+    close(fd);
+    std::string link = std::string(path) + ".link";
+    BOOST_REQUIRE_EQUAL(::link(path, link.c_str()), 0);
+
+    // Both through the same name and through a hard link
+    mms::CompactStats stats = mms::compactFile< Index<mms::Mmapped> >(path, path);
+    BOOST_CHECK_EQUAL(stats.oldSize, old.size());
+    stats = mms::compactFile< Index<mms::Mmapped> >(link, path);
+    BOOST_CHECK_EQUAL(stats.oldSize, old.size());
+
+    mms::FileMapping result(path);
+    BOOST_CHECK_EQUAL(result.size(), stats.newSize);
+    checkIndex(mms::safeCast< Index<mms::Mmapped> >(result.data(), result.size()), 1000);
+
+    unlink(path);
+    unlink(link.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( compact_unordered )
+{
+    typedef mms::unordered_map< mms::Standalone, int, mms::vector<mms::Standalone, int> > Map;
+    typedef mms::unordered_set< mms::Standalone, mms::string<mms::Standalone> > Set;
+    Map m;
+    Set s;
+    for (int i = 0; i != 1000; ++i) {
+        m[i].assign(i % 5, i);
+        std::ostringstream name;
+        name << "name #" << i;
+        s.insert(name.str());
+    }
+    Map empty;
+
+    mms::BufferWriter old;
+    mms::vector<mms::Standalone, int> garbage(10000, 42);
+    mms::write(old, garbage);
+    old.setBodyAlignment(1024);
+    size_t mapPos = mms::write(old, m);
+    size_t setPos = mms::write(old, s);
+    size_t emptyPos = mms::write(old, empty);
+
+    const Map::MmappedType& mmMap = *reinterpret_cast<const Map::MmappedType*>(old.data() + mapPos);
+    mms::BufferWriter w;
+    mms::compact(w, mmMap);
+    const Map::MmappedType& map = w.safeCast<Map::MmappedType>();
+    BOOST_CHECK(w.size() < old.size() / 2);
+    BOOST_REQUIRE_EQUAL(map.size(), 1000u);
+    BOOST_CHECK_EQUAL(map.bucket_count(), mmMap.bucket_count());
+    for (int i = 0; i != 1000; ++i) {
+        BOOST_REQUIRE_EQUAL(map[i].size(), (size_t) i % 5);
+        if (i % 5)
+            BOOST_CHECK_EQUAL(map[i][0], i);
+    }
+    BOOST_CHECK(map.find(1000) == map.end());
+
+    const Set::MmappedType& mmSet = *reinterpret_cast<const Set::MmappedType*>(old.data() + setPos);
+    mms::BufferWriter ws;
+    mms::compact(ws, mmSet, mms::BreadthFirst);
+    const Set::MmappedType& set = ws.safeCast<Set::MmappedType>();
+    BOOST_REQUIRE_EQUAL(set.size(), 1000u);
+    BOOST_CHECK(set.count("name #123"));
+    BOOST_CHECK(!set.count("name #1000"));
+
+    mms::BufferWriter we;
+    mms::compact(we, *reinterpret_cast<const Map::MmappedType*>(old.data() + emptyPos));
+    BOOST_CHECK(we.safeCast<Map::MmappedType>().empty());
+}
+
+BOOST_AUTO_TEST_CASE( access_profile )
+{
+    mms::AccessProfile profile;
+    profile.hot("records[].values").hot("byName");
+    BOOST_CHECK(profile.isHot(""));
+    BOOST_CHECK(profile.isHot("records"));
+    BOOST_CHECK(profile.isHot("records[]"));
+    BOOST_CHECK(profile.isHot("records[].values"));
+    BOOST_CHECK(!profile.isHot("records[].values[]"));
+    BOOST_CHECK(!profile.isHot("records[].name"));
+    BOOST_CHECK(profile.isHot("byName"));
+    BOOST_CHECK(!profile.isHot("byName[].first"));
+    BOOST_CHECK(!profile.isHot("byNa"));
+
+    struct Row { std::string path; size_t pages; size_t accessedPages; };
+    Row rows[] = {
+        { "(root)", 1, 1 }, { "records", 10, 1 }, { "byName", 2, 2 },
+        { "records[].name", 5, 0 }, { "(total)", 18, 4 }
+    };
+    std::vector<Row> v(rows, rows + sizeof(rows) / sizeof(rows[0]));
+    mms::AccessProfile any = mms::AccessProfile::fromResidency(v);
+    BOOST_CHECK_EQUAL(any.hotPaths().size(), 2u);
+    BOOST_CHECK(any.hotPaths().count("records") && any.hotPaths().count("byName"));
+    mms::AccessProfile most = mms::AccessProfile::fromResidency(v, 0.5);
+    BOOST_CHECK_EQUAL(most.hotPaths().size(), 1u);
+    BOOST_CHECK(most.hotPaths().count("byName"));
+}
+
+BOOST_AUTO_TEST_CASE( compact_by_profile )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+    mms::BufferWriter old;
+    writeFragmented(old, src);
+
+    mms::AccessProfile profile;
+    profile.hot("byName[].first").hot("records[].values");
+    mms::BufferWriter w;
+    mms::compact(w, old.safeCast< Index<mms::Mmapped> >(), profile);
+    const Index<mms::Mmapped>& idx = w.safeCast< Index<mms::Mmapped> >();
+    checkIndex(idx, 1000);
+
+    // Hot bodies follow all cold ones
+    const char* firstHot = reinterpret_cast<const char*>(idx.byName.begin());
+    firstHot = std::min(firstHot, reinterpret_cast<const char*>(idx.records.begin()));
+    const char* lastCold = 0;
+    for (size_t i = 0; i != idx.records.size(); ++i) {
+        const Record<mms::Mmapped>& r = idx.records[i];
+        lastCold = std::max(lastCold, r.name.c_str() + r.name.size());
+        for (size_t j = 0; j != r.values.size(); ++j)
+            lastCold = std::max(lastCold, reinterpret_cast<const char*>(r.values[j].end()));
+        if (!r.values.empty())
+            firstHot = std::min(firstHot, reinterpret_cast<const char*>(r.values.begin()));
+    }
+    for (mms::map< mms::Mmapped, mms::string<mms::Mmapped>, int >::const_iterator
+         i = idx.byName.begin(), ie = idx.byName.end(); i != ie; ++i)
+    {
+        firstHot = std::min(firstHot, i->first.c_str());
+    }
+    BOOST_CHECK(lastCold != 0);
+    BOOST_CHECK(lastCold <= firstHot);
+}
+
+BOOST_AUTO_TEST_CASE( write_by_profile )
+{
+    Index<mms::Standalone> src = genIndex(1000);
+
+    // With nothing hot, data is laid out as usual
+    mms::BufferWriter fresh;
+    mms::safeWrite(fresh, src);
+    mms::BufferWriter cold;
+    mms::safeWrite(cold, src, mms::AccessProfile());
+    BOOST_CHECK(std::string(fresh.data(), fresh.size()) == std::string(cold.data(), cold.size()));
+
+    mms::BufferWriter hot;
+    mms::safeWrite(hot, src, mms::AccessProfile().hot("records[].name"));
+    BOOST_CHECK_EQUAL(hot.size(), fresh.size());
+    const Index<mms::Mmapped>& idx = hot.safeCast< Index<mms::Mmapped> >();
+    checkIndex(idx, 1000);
+    BOOST_CHECK(reinterpret_cast<const char*>(idx.byName.begin()) < idx.records[0].name.c_str());
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/ptr.h>
+
+#if MMS_USE_CXX11
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template<class P>
+struct Node: public mms::Pointee {
+    int id;
+    mms::string<P> name;
+    mms::shared_ptr< P, Node<P> > next;
+
+    explicit Node(int id): id(id), name(std::string(id % 17 + 1, 'n')) {}
+    template<class A> void traverseFields(A a) const { a(id)(name)(next); }
+};
+
+template<class P>
+struct Shard {
+    mms::vector< P, mms::shared_ptr< P, Node<P> > > nodes;
+    mms::shared_ptr< P, Node<P> > first;
+
+    template<class A> void traverseFields(A a) const { a(nodes)(first); }
+};
+
+typedef mms::shared_ptr< mms::Standalone, Node<mms::Standalone> > NodePtr;
+
+// Nodes form chains, every shard referring to nodes of several of them
+std::vector<NodePtr> genNodes(size_t count)
+{
+    std::vector<NodePtr> nodes;
+    for (size_t i = 0; i != count; ++i) {
+        nodes.push_back(NodePtr(new Node<mms::Standalone>(i)));
+        if (i % 10)
+            nodes[i - 1]->next = nodes[i];
+    }
+    return nodes;
+}
+
+std::vector< Shard<mms::Standalone> > genShards(const std::vector<NodePtr>& nodes, size_t count)
+{
+    std::vector< Shard<mms::Standalone> > shards(count);
+    for (size_t i = 0; i != count; ++i) {
+        for (size_t j = i; j < nodes.size(); j += count / 2 + 1)
+            shards[i].nodes.push_back(nodes[j]);
+        shards[i].first = nodes[i * 7 % nodes.size()];
+    }
+    return shards;
+}
+
+std::string serialize(const Shard<mms::Standalone>& shard)
+{
+    mms::BufferWriter w;
+    mms::write(w, shard);
+    return std::string(w.data(), w.size());
+}
+
+void checkShard(const std::string& buf, const Shard<mms::Standalone>& shard)
+{
+    const Shard<mms::Mmapped>& mm = mms::safeCast< Shard<mms::Mmapped> >(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.nodes.size(), shard.nodes.size());
+    for (size_t i = 0; i != mm.nodes.size(); ++i) {
+        BOOST_CHECK_EQUAL(mm.nodes[i]->id, shard.nodes[i]->id);
+        BOOST_CHECK_EQUAL(mm.nodes[i]->name, shard.nodes[i]->name);
+        if (shard.nodes[i]->next)
+            BOOST_CHECK_EQUAL(mm.nodes[i]->next->id, shard.nodes[i]->next->id);
+    }
+    BOOST_CHECK_EQUAL(mm.first->id, shard.first->id);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( concurrent_writers_shared_pointees )
+{
+    const size_t threads = 8;
+    const size_t rounds = 100;
+    std::vector<NodePtr> nodes = genNodes(1000);
+    std::vector< Shard<mms::Standalone> > shards = genShards(nodes, threads);
+
+    std::vector<std::string> expected;
+    for (size_t i = 0; i != threads; ++i)
+        expected.push_back(serialize(shards[i]));
+    for (size_t i = 0; i != threads; ++i)
+        checkShard(expected[i], shards[i]);
+
+    std::vector<size_t> mismatches(threads, 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i != threads; ++i) {
+        workers.emplace_back([&, i] {
+            for (size_t round = 0; round != rounds; ++round) {
+                // Shards are written in different order by each thread
+                const size_t k = (i + round) % threads;
+                if (serialize(shards[k]) != expected[k])
+                    ++mismatches[i];
+            }
+        });
+    }
+    for (size_t i = 0; i != threads; ++i)
+        workers[i].join();
+
+    for (size_t i = 0; i != threads; ++i)
+        BOOST_CHECK_EQUAL(mismatches[i], 0u);
+}
+
+BOOST_AUTO_TEST_CASE( writer_ids_unique_across_threads )
+{
+    const size_t threads = 8;
+    const size_t perThread = 10000;
+    std::vector< std::vector<mms::impl::WriterID> > ids(threads);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i != threads; ++i) {
+        workers.emplace_back([&, i] {
+            for (size_t j = 0; j != perThread; ++j) {
+                mms::BufferWriter w;
+                ids[i].push_back(w.id());
+            }
+        });
+    }
+    for (size_t i = 0; i != threads; ++i)
+        workers[i].join();
+
+    std::vector<size_t> all;
+    for (size_t i = 0; i != threads; ++i)
+        for (size_t j = 0; j != perThread; ++j)
+            all.push_back(ids[i][j].first);
+    std::sort(all.begin(), all.end());
+    BOOST_CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+}
+
+#endif // MMS_USE_CXX11
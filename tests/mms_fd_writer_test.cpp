@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/fd_writer.h>
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include "tools.h"
+
+#include <sstream>
+#include <cstdio>
+
+BOOST_AUTO_TEST_CASE( fd_writer )
+{
+    size_t bufferSizes[] = { 16, 100, 4096, mms::FdWriter::DEFAULT_BUFFER_SIZE };
+    size_t bodySizes[] = { 0, 1, 10, 1000, 100000 };
+
+    for (size_t b = 0; b != sizeof(bufferSizes) / sizeof(*bufferSizes); ++b) {
+        for (size_t s = 0; s != sizeof(bodySizes) / sizeof(*bodySizes); ++s) {
+            Doc<mms::Standalone> doc = genDoc(bodySizes[s]);
+
+            std::stringstream expected;
+            size_t expectedPos = mms::safeWrite(expected, doc);
+
+            FILE* f = tmpfile();
+            BOOST_REQUIRE(f);
+            size_t pos;
+            {
+                mms::FdWriter w(fileno(f), bufferSizes[b]);
+                pos = mms::safeWrite(w, doc);
+                BOOST_CHECK_EQUAL(w.pos(), expected.str().size());
+            }
+            std::string actual = readAll(fileno(f));
+            fclose(f);
+
+            BOOST_CHECK_EQUAL(pos, expectedPos);
+            BOOST_CHECK(actual == expected.str());
+
+            const Doc<mms::Mmapped>& mm =
+                mms::safeCast< Doc<mms::Mmapped> >(actual.data(), actual.size());
+            BOOST_CHECK_EQUAL(mm.id, 17);
+            BOOST_CHECK_EQUAL(mm.body.size(), bodySizes[s]);
+            BOOST_CHECK_EQUAL(mm.title, doc.title);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( fd_writer_explicit_flush )
+{
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f);
+    mms::FdWriter w(fileno(f));
+    mms::string<mms::Standalone> s("hello");
+    mms::unsafeWrite(w, s);
+
+    BOOST_CHECK(readAll(fileno(f)).empty());
+    w.flush();
+    std::string buf = readAll(fileno(f));
+    BOOST_CHECK_EQUAL(buf.size(), w.pos());
+    BOOST_CHECK_EQUAL(mms::cast< mms::string<mms::Mmapped> >(buf.data(), buf.size()), "hello");
+    fclose(f);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/copy.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+
+#include "tools.h"
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Point {
+    int x;
+    int y;
+    double weight;
+
+    Point(): x(0), y(0), weight(0) {}
+    Point(int x, int y, double w): x(x), y(y), weight(w) {}
+
+    template<class A> void traverseFields(A a) const { a(x)(y)(weight); }
+};
+
+// Same fields as Point, but not trivially copyable
+template<class P>
+struct NontrivialPoint {
+    int x;
+    int y;
+    double weight;
+
+    NontrivialPoint(): x(0), y(0), weight(0) {}
+    NontrivialPoint(int x, int y, double w): x(x), y(y), weight(w) {}
+    NontrivialPoint(const NontrivialPoint& p): x(p.x), y(p.y), weight(p.weight) {}
+    NontrivialPoint& operator = (const NontrivialPoint& p)
+    {
+        x = p.x; y = p.y; weight = p.weight;
+        return *this;
+    }
+
+    template<class A> void traverseFields(A a) const { a(x)(y)(weight); }
+};
+
+template<class P>
+struct Segment {
+    Point<P> from;
+    Point<P> to;
+
+    template<class A> void traverseFields(A a) const { a(from)(to); }
+};
+
+// Structs without constructors are trivial and are written as they are
+// anyway, so the ones below have constructors to be written field by field
+
+template<class P>
+struct Padded {
+    char tag;
+    double value;
+
+    Padded(): tag(0), value(0) {}
+
+    template<class A> void traverseFields(A a) const { a(tag)(value); }
+};
+
+template<class P>
+struct Partial {
+    int x;
+    int y;
+
+    Partial(): x(0), y(0) {}
+    template<class A> void traverseFields(A a) const { a(x); }
+};
+
+template<class P>
+struct Named {
+    int id;
+    mms::string<P> name;
+
+    template<class A> void traverseFields(A a) const { a(id)(name); }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( flat_layout_detection )
+{
+    using mms::impl::hasFlatLayout;
+
+    BOOST_CHECK(hasFlatLayout<int>());
+    BOOST_CHECK(hasFlatLayout< Point<mms::Standalone> >());
+    BOOST_CHECK(hasFlatLayout< Segment<mms::Standalone> >());
+
+    BOOST_CHECK(!hasFlatLayout< NontrivialPoint<mms::Standalone> >());
+    BOOST_CHECK(!hasFlatLayout< Padded<mms::Standalone> >());
+    BOOST_CHECK(!hasFlatLayout< Partial<mms::Standalone> >());
+    BOOST_CHECK(!hasFlatLayout< Named<mms::Standalone> >());
+    BOOST_CHECK(!hasFlatLayout< mms::string<mms::Standalone> >());
+}
+
+BOOST_AUTO_TEST_CASE( flat_layout_write )
+{
+    mms::vector< mms::Standalone, Point<mms::Standalone> > flat;
+    mms::vector< mms::Standalone, NontrivialPoint<mms::Standalone> > fieldwise;
+    for (int i = 0; i != 1000; ++i) {
+        flat.push_back(Point<mms::Standalone>(i, -i, i * 0.5));
+        fieldwise.push_back(NontrivialPoint<mms::Standalone>(i, -i, i * 0.5));
+    }
+
+    std::string buf = serialize(flat);
+    BOOST_CHECK(buf == serialize(fieldwise));
+
+    const mms::vector< mms::Mmapped, Point<mms::Mmapped> >& v =
+        mms::cast< mms::vector< mms::Mmapped, Point<mms::Mmapped> > >(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(v.size(), 1000u);
+    for (int i = 0; i != 1000; ++i) {
+        BOOST_CHECK_EQUAL(v[i].x, i);
+        BOOST_CHECK_EQUAL(v[i].y, -i);
+        BOOST_CHECK_EQUAL(v[i].weight, i * 0.5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flat_layout_copy )
+{
+    mms::vector< mms::Standalone, Segment<mms::Standalone> > segments;
+    for (int i = 0; i != 100; ++i) {
+        Segment<mms::Standalone> s;
+        s.from = Point<mms::Standalone>(i, i, 1);
+        s.to = Point<mms::Standalone>(i + 1, i * 2, 2);
+        segments.push_back(s);
+    }
+
+    std::string buf = serialize(segments);
+    const mms::vector< mms::Mmapped, Segment<mms::Mmapped> >& mm =
+        mms::cast< mms::vector< mms::Mmapped, Segment<mms::Mmapped> > >(buf.data(), buf.size());
+
+    mms::vector< mms::Standalone, Segment<mms::Standalone> > copy(mm);
+    BOOST_REQUIRE_EQUAL(copy.size(), segments.size());
+    for (size_t i = 0; i != copy.size(); ++i) {
+        BOOST_CHECK_EQUAL(copy[i].from.x, segments[i].from.x);
+        BOOST_CHECK_EQUAL(copy[i].from.y, segments[i].from.y);
+        BOOST_CHECK_EQUAL(copy[i].to.x, segments[i].to.x);
+        BOOST_CHECK_EQUAL(copy[i].to.weight, segments[i].to.weight);
+    }
+
+    // Assignment replaces the contents
+    copy.assign(3, Segment<mms::Standalone>());
+    copy = mm;
+    BOOST_CHECK_EQUAL(copy.size(), segments.size());
+
+    mms::vector< mms::Standalone, Segment<mms::Standalone> > empty;
+    std::string emptyBuf = serialize(empty);
+    copy = mms::cast< mms::vector< mms::Mmapped, Segment<mms::Mmapped> > >(
+        emptyBuf.data(), emptyBuf.size());
+    BOOST_CHECK(copy.empty());
+}
+
+BOOST_AUTO_TEST_CASE( flat_layout_bools )
+{
+    mms::vector<mms::Standalone, bool> v;
+    for (size_t i = 0; i != 100; ++i)
+        v.push_back(i % 3 == 0);
+
+    std::string buf = serialize(v);
+    const mms::vector<mms::Mmapped, bool>& mm =
+        mms::cast< mms::vector<mms::Mmapped, bool> >(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    for (size_t i = 0; i != v.size(); ++i)
+        BOOST_CHECK_EQUAL(mm[i], v[i]);
+
+    mms::vector<mms::Standalone, bool> copy(mm);
+    BOOST_CHECK(copy == v);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/ptr.h>
+#include <mms/transient.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Plain {
+    int i;
+    mms::string<P> str;
+    mms::map<P, mms::string<P>, mms::vector<P, int> > map;
+
+    template<class A> void traverseFields(A a) const { a(i)(str)(map); }
+};
+
+template<class P>
+struct WithTransient {
+    int i;
+    mms::transient<P, int> t;
+
+    template<class A> void traverseFields(A a) const { a(i)(t); }
+};
+
+template<class P>
+struct Tree {
+    int value;
+    mms::vector<P, Tree<P> > children;
+
+    template<class A> void traverseFields(A a) const { a(value)(children); }
+};
+
+template<class T>
+std::string twoPassWrite(const T& t)
+{
+    std::stringstream out;
+    mms::Writer w(out);
+    mms::impl::layOut(w, t, true);
+    mms::impl::write(w, t, true);
+    return out.str();
+}
+
+template<class T>
+std::string write(const T& t)
+{
+    std::stringstream out;
+    mms::safeWrite(out, t);
+    return out.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( needs_layout )
+{
+    using mms::impl::needsLayout;
+    using mms::Standalone;
+
+    BOOST_CHECK(!needsLayout<int>());
+    BOOST_CHECK(!needsLayout< mms::string<Standalone> >());
+    BOOST_CHECK((!needsLayout< mms::vector<Standalone, int> >()));
+    BOOST_CHECK(!needsLayout< Plain<Standalone> >());
+    BOOST_CHECK((!needsLayout< mms::vector<Standalone, Plain<Standalone> > >()));
+    BOOST_CHECK(!needsLayout< Tree<Standalone> >());
+
+    BOOST_CHECK(needsLayout< WithTransient<Standalone> >());
+    BOOST_CHECK((needsLayout< mms::vector<Standalone, WithTransient<Standalone> > >()));
+    BOOST_CHECK((needsLayout< mms::ptr<Standalone, InnerPtr<Standalone> > >()));
+    BOOST_CHECK(needsLayout< OuterPtr<Standalone> >());
+    BOOST_CHECK((needsLayout< std::pair<int, mms::transient<Standalone, int> > >()));
+}
+
+BOOST_AUTO_TEST_CASE( single_pass_output )
+{
+    Plain<mms::Standalone> p;
+    p.i = 42;
+    p.str = "a string";
+    for (int i = 0; i != 100; ++i) {
+        mms::vector<mms::Standalone, int>& v = p.map[std::string(i % 7 + 1, 'a' + i % 26)];
+        v.push_back(i);
+        v.push_back(i * i);
+    }
+    BOOST_CHECK(write(p) == twoPassWrite(p));
+
+    Tree<mms::Standalone> tree;
+    tree.value = 1;
+    tree.children.resize(3);
+    tree.children[1].value = 2;
+    tree.children[1].children.resize(2);
+    tree.children[1].children[0].value = 3;
+    BOOST_CHECK(write(tree) == twoPassWrite(tree));
+
+    std::string buf = write(tree);
+    const Tree<mms::Mmapped>& mm = mms::cast< Tree<mms::Mmapped> >(buf.data(), buf.size());
+    BOOST_CHECK_EQUAL(mm.value, 1);
+    BOOST_REQUIRE_EQUAL(mm.children.size(), 3);
+    BOOST_CHECK_EQUAL(mm.children[1].value, 2);
+    BOOST_REQUIRE_EQUAL(mm.children[1].children.size(), 2);
+    BOOST_CHECK_EQUAL(mm.children[1].children[0].value, 3);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "tools.h"
+
+#include <mms/mapped_file.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/transient.h>
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > MmStrings;
+
+template<class P>
+struct Counted {
+    mms::vector<P, int> items;
+    mms::transient<P, int> hits;
+
+    template<class A> void traverseFields(A a) const { a(items)(hits); }
+};
+
+void checkMapped(const TempFile& f, const Strings& v, const mms::MapPolicy& policy)
+{
+    mms::MappedFile<MmStrings> m(f.path(), policy);
+    BOOST_CHECK_EQUAL(m.path(), f.path());
+    BOOST_CHECK_EQUAL(m.size(), f.read().size());
+    BOOST_REQUIRE_EQUAL(m->size(), v.size());
+    for (size_t i = 0; i != v.size(); ++i)
+        BOOST_REQUIRE_EQUAL((*m)[i], v[i]);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( mapped_file_policies )
+{
+    TempFile f;
+    Strings v = genStrings(300000);
+    f.write(v);
+
+    checkMapped(f, v, mms::MapPolicy());
+    checkMapped(f, v, mms::MapPolicy().populate());
+    checkMapped(f, v, mms::MapPolicy().advise(mms::MapPolicy::Random));
+    checkMapped(f, v, mms::MapPolicy().advise(mms::MapPolicy::Sequential));
+    checkMapped(f, v, mms::MapPolicy().advise(mms::MapPolicy::WillNeed));
+    checkMapped(f, v, mms::MapPolicy().privateWritable().populate());
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_huge_pages )
+{
+    TempFile f;
+    Strings v = genStrings(300000);
+    f.write(v);
+
+    mms::MappedFile<MmStrings> m(f.path(), mms::MapPolicy().hugePages());
+    BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(m.data()) % mms::FileMapping::HUGE_PAGE_SIZE, 0);
+    BOOST_REQUIRE_EQUAL(m->size(), v.size());
+    BOOST_CHECK_EQUAL((*m)[123456], v[123456]);
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_lock )
+{
+    TempFile f;
+    Strings v = genStrings(1000);
+    f.write(v);
+
+    {
+        mms::MappedFile<MmStrings> m(f.path(), mms::MapPolicy().lock(4096));
+        BOOST_CHECK_EQUAL(m.lockedSize(), 4096);
+    }
+    {
+        mms::MappedFile<MmStrings> m(f.path(), mms::MapPolicy().lock());
+        BOOST_CHECK_EQUAL(m.lockedSize(), m.size());
+        BOOST_CHECK_EQUAL((*m)[999], v[999]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_private )
+{
+    Counted<mms::Standalone> c;
+    c.items.assign(1000, 42);
+    TempFile f;
+    f.write(c);
+    std::string original = f.read();
+
+    {
+        mms::MappedFile< Counted<mms::Mmapped> > m(f.path(), mms::MapPolicy().privateWritable());
+        BOOST_CHECK_EQUAL(*m->hits, 0);
+        *m->hits = 10;
+        BOOST_CHECK_EQUAL(*m->hits, 10);
+        BOOST_CHECK_EQUAL(m->items[999], 42);
+        m.mutableData()[0] = 1;
+    }
+    BOOST_CHECK(f.read() == original);
+
+    mms::MappedFile< Counted<mms::Mmapped> > shared(f.path());
+    BOOST_CHECK_THROW(shared.mutableData(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_errors )
+{
+    BOOST_CHECK_THROW(mms::MappedFile<MmStrings>("/nonexistent/file.mms"), std::runtime_error);
+
+    TempFile empty;
+    BOOST_CHECK_THROW(mms::MappedFile<MmStrings> m(empty.path()), std::runtime_error);
+
+    TempFile f;
+    f.write(mms::string<mms::Standalone>("a string, not a vector"));
+    BOOST_CHECK_THROW(mms::MappedFile<MmStrings> m(f.path()), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_prefault )
+{
+    TempFile f;
+    Strings v = genStrings(300000);
+    f.write(v);
+
+    cpu_set_t before, after;
+    BOOST_REQUIRE_EQUAL(sched_getaffinity(0, sizeof(before), &before), 0);
+
+    checkMapped(f, v, mms::MapPolicy().prefault(1));
+    checkMapped(f, v, mms::MapPolicy().prefault(4));
+    checkMapped(f, v, mms::MapPolicy().prefault().numaNodes());
+    checkMapped(f, v, mms::MapPolicy().prefault(2).privateWritable());
+
+    // Prefaulting threads (the calling one included) are unbound afterwards
+    BOOST_REQUIRE_EQUAL(sched_getaffinity(0, sizeof(after), &after), 0);
+    BOOST_CHECK(CPU_EQUAL(&before, &after));
+
+    mms::MappedFile<MmStrings> m(f.path(), mms::MapPolicy().prefault(2));
+    size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> pages((m.size() + page - 1) / page);
+    BOOST_REQUIRE_EQUAL(mincore(const_cast<char*>(m.data()), m.size(), &pages[0]), 0);
+    for (size_t i = 0; i != pages.size(); ++i)
+        BOOST_REQUIRE(pages[i] & 1);
+    BOOST_CHECK(m.loadSeconds() > 0);
+}
+
+BOOST_AUTO_TEST_CASE( mapped_file_prefault_bandwidth )
+{
+    TempFile f;
+    Strings v = genStrings(300000);
+    f.write(v);
+
+    // Everything but the first chunk waits for its turn
+    mms::MappedFile<MmStrings> m(f.path(), mms::MapPolicy().prefault(2).bandwidth(16 << 20));
+    const size_t chunk = mms::impl::PrefaultOptions().chunkSize;
+    const double expected = double(m.size() - chunk) / (16 << 20);
+    BOOST_CHECK(m.loadSeconds() >= expected * 0.9);
+    BOOST_CHECK_EQUAL((*m)[123456], v[123456]);
+}
+
+BOOST_AUTO_TEST_CASE( numa_node_cpus )
+{
+    std::vector<cpu_set_t> nodes = mms::impl::numaNodeCpus();
+    // Nodes may be unknown in a container, but listed ones have CPUs
+    for (size_t i = 0; i != nodes.size(); ++i)
+        BOOST_CHECK(CPU_COUNT(&nodes[i]) > 0);
+}
+
+BOOST_AUTO_TEST_CASE( sysfs_lists )
+{
+    TempFile f;
+    {
+        std::ofstream out(f.path().c_str());
+        out << "0-1,3,8-9\n";
+    }
+    int expected[] = { 0, 1, 3, 8, 9 };
+    std::vector<int> list = mms::impl::readSysfsList(f.path());
+    BOOST_CHECK_EQUAL_COLLECTIONS(list.begin(), list.end(), expected, expected + 5);
+    BOOST_CHECK(mms::impl::readSysfsList(f.path() + ".missing").empty());
+}
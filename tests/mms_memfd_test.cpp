@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "tools.h"
+
+#include <mms/memfd.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace {
+
+typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > MmStrings;
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( memfd_publish )
+{
+    Strings v = genStrings(100000);
+    std::ostringstream expected;
+    mms::safeWrite(expected, v);
+
+    int fd = mms::publish(v, "mms_test");
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_CHECK_EQUAL(fcntl(fd, F_GET_SEALS), int(mms::MemfdWriter::SEALS));
+
+    // Sealed: neither writable nor resizable
+    BOOST_CHECK(write(fd, "x", 1) == -1);
+    BOOST_CHECK(ftruncate(fd, 0) == -1);
+    BOOST_CHECK(fcntl(fd, F_ADD_SEALS, 0) == -1);
+
+    mms::SealedMapping m(fd);
+    BOOST_REQUIRE_EQUAL(m.size(), expected.str().size());
+    BOOST_CHECK(std::string(m.data(), m.size()) == expected.str());
+    const MmStrings& mm = m.safeCast<MmStrings>();
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    BOOST_CHECK_EQUAL(mm[12345], v[12345]);
+}
+
+BOOST_AUTO_TEST_CASE( memfd_exact_size )
+{
+    typedef mms::map< mms::Standalone, int, mms::string<mms::Standalone> > Map;
+    Map m;
+    for (int i = 0; i != 10000; ++i)
+        m[i] = std::string(i % 5, 'x');
+
+    mms::MemfdWriter w;
+    mms::safeWrite(w, m);
+    size_t size = w.pos();
+    BOOST_CHECK(w.capacity() >= size);
+    mms::SealedMapping mapping(w.seal());
+    BOOST_CHECK_EQUAL(mapping.size(), size);
+    BOOST_CHECK_EQUAL(
+        (mapping.safeCast< mms::map< mms::Mmapped, int, mms::string<mms::Mmapped> > >()[1234]),
+        "xxxx");
+}
+
+BOOST_AUTO_TEST_CASE( memfd_unsealed_rejected )
+{
+    int fd = mms::impl::memfdCreate("mms_test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    BOOST_REQUIRE(fd >= 0);
+    std::ostringstream out;
+    mms::safeWrite(out, genStrings(10));
+    BOOST_REQUIRE(write(fd, out.str().data(), out.str().size()) == (ssize_t) out.str().size());
+    // Takes the descriptor even if throwing
+    BOOST_CHECK_THROW(mms::SealedMapping m(fd), std::runtime_error);
+    BOOST_CHECK(fcntl(fd, F_GETFD) == -1 && errno == EBADF);
+}
+
+BOOST_AUTO_TEST_CASE( memfd_two_processes )
+{
+    int socks[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0);
+
+    pid_t pid = fork();
+    BOOST_REQUIRE(pid >= 0);
+    if (pid == 0) {
+        // Publisher: no Boost.Test here, only the exit code matters
+        int status = 1;
+        try {
+            close(socks[0]);
+            int fd = mms::publish(genStrings(100000));
+            mms::sendFd(socks[1], fd);
+            close(fd);
+            status = 0;
+        }
+        catch (...) {}
+        _exit(status);
+    }
+
+    close(socks[1]);
+    {
+        mms::SealedMapping m(mms::receiveFd(socks[0]));
+        close(socks[0]);
+
+        int status;
+        BOOST_REQUIRE_EQUAL(waitpid(pid, &status, 0), pid);
+        BOOST_REQUIRE(WIFEXITED(status));
+        BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+
+        // Still readable after the publisher is gone
+        Strings expected = genStrings(100000);
+        const MmStrings& mm = m.safeCast<MmStrings>();
+        BOOST_REQUIRE_EQUAL(mm.size(), expected.size());
+        for (size_t i = 0; i != mm.size(); ++i)
+            BOOST_REQUIRE_EQUAL(mm[i], expected[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( memfd_closed_socket )
+{
+    int socks[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, socks), 0);
+    close(socks[1]);
+    BOOST_CHECK_THROW(mms::receiveFd(socks[0]), std::runtime_error);
+    close(socks[0]);
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+#include "tools.h"
+
+#include <mms/mmap_file_writer.h>
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/ptr.h>
+
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+
+class TempDir {
+public:
+    TempDir()
+    {
+        char name[] = "/tmp/mms_test.XXXXXX";
+        BOOST_REQUIRE(mkdtemp(name));
+        path_ = name;
+    }
+
+    ~TempDir()
+    {
+        std::vector<std::string> f = files();
+        for (std::vector<std::string>::iterator i = f.begin(), ie = f.end(); i != ie; ++i)
+            unlink((path_ + "/" + *i).c_str());
+        rmdir(path_.c_str());
+    }
+
+    const std::string& path() const { return path_; }
+
+    std::vector<std::string> files() const
+    {
+        std::vector<std::string> result;
+        DIR* dir = opendir(path_.c_str());
+        while (struct dirent* e = readdir(dir))
+            if (std::string(e->d_name) != "." && std::string(e->d_name) != "..")
+                result.push_back(e->d_name);
+        closedir(dir);
+        return result;
+    }
+
+private:
+    std::string path_;
+};
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream in(path.c_str());
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( mmap_file_writer )
+{
+    typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+    Strings v = genStrings(100000);
+
+    std::stringstream expected;
+    mms::safeWrite(expected, v);
+
+    TempDir dir;
+    std::string path = dir.path() + "/out.mms";
+    {
+        mms::MmapFileWriter w(path);
+        mms::safeWrite(w, v);
+        BOOST_CHECK_EQUAL(dir.files().size(), 1);
+        BOOST_CHECK(dir.files()[0] != "out.mms");
+        w.commit();
+    }
+    BOOST_REQUIRE_EQUAL(dir.files().size(), 1);
+    BOOST_CHECK_EQUAL(dir.files()[0], "out.mms");
+
+    std::string actual = readFile(path);
+    BOOST_CHECK(actual == expected.str());
+    const mms::vector< mms::Mmapped, mms::string<mms::Mmapped> >& mm =
+        mms::safeCast< mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > >(
+            actual.data(), actual.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    BOOST_CHECK_EQUAL(mm[12345], v[12345]);
+}
+
+BOOST_AUTO_TEST_CASE( mmap_file_writer_exact_size )
+{
+    typedef mms::shared_ptr< mms::Standalone, OuterPtr<mms::Standalone> > Ptr;
+    Ptr p(new OuterPtr<mms::Standalone>(10000));
+
+    TempDir dir;
+    std::string path = dir.path() + "/out.mms";
+    mms::MmapFileWriter w(path);
+    mms::safeWrite(w, p);
+    // Allocated once, after the layout pass
+    const size_t page = mms::MmapFileWriter::ALIGNMENT;
+    BOOST_CHECK_EQUAL(w.capacity(), (w.pos() + page - 1) / page * page);
+    w.commit();
+
+    std::string actual = readFile(path);
+    BOOST_CHECK_EQUAL(actual.size(), w.pos());
+    const mms::shared_ptr< mms::Mmapped, OuterPtr<mms::Mmapped> >& mm =
+        mms::safeCast< mms::shared_ptr< mms::Mmapped, OuterPtr<mms::Mmapped> > >(
+            actual.data(), actual.size());
+    BOOST_REQUIRE_EQUAL(mm->inners.size(), 10000);
+    BOOST_CHECK_EQUAL(mm->inners[42]->x, 42);
+}
+
+BOOST_AUTO_TEST_CASE( mmap_file_writer_reserve )
+{
+    typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+    Strings v = genStrings(100000);
+
+    TempDir dir;
+    std::string path = dir.path() + "/out.mms";
+    mms::MmapFileWriter w(path);
+    // No layout pass for strings, so the size has to be given explicitly
+    w.reserve(mms::safeSerializedSize(v));
+    size_t capacity = w.capacity();
+    mms::safeWrite(w, v);
+    BOOST_CHECK_EQUAL(w.capacity(), capacity);
+    const size_t page = mms::MmapFileWriter::ALIGNMENT;
+    BOOST_CHECK_EQUAL(w.capacity(), (w.pos() + page - 1) / page * page);
+    w.commit();
+    BOOST_CHECK_EQUAL(readFile(path).size(), w.pos());
+}
+
+BOOST_AUTO_TEST_CASE( mmap_file_writer_discard )
+{
+    TempDir dir;
+    std::string path = dir.path() + "/out.mms";
+    {
+        std::ofstream old(path.c_str());
+        old << "old contents";
+    }
+    {
+        mms::MmapFileWriter w(path);
+        mms::safeWrite(w, mms::string<mms::Standalone>("new contents"));
+    }
+    BOOST_REQUIRE_EQUAL(dir.files().size(), 1);
+    BOOST_CHECK_EQUAL(readFile(path), "old contents");
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+
+#if MMS_USE_CXX11
+
+namespace {
+
+struct alignas(32) Vec8f {
+    float v[8];
+};
+
+struct alignas(64) Line {
+    int id;
+    char payload[20];
+};
+
+template<class P>
+struct alignas(64) Block {
+    int id;
+    mms::vector<P, Vec8f> vecs;
+    mms::string<P> name;
+
+    template<class A> void traverseFields(A a) const { a(id)(vecs)(name); }
+};
+
+template<class P>
+struct Doc {
+    mms::string<P> title;  // leaves data position unaligned
+    mms::vector<P, Vec8f> vecs;
+    mms::vector<P, Line> lines;
+    mms::vector< P, Block<P> > blocks;
+    mms::map<P, int, Line> byId;
+
+    template<class A> void traverseFields(A a) const { a(title)(vecs)(lines)(blocks)(byId); }
+};
+
+Vec8f vec(float x)
+{
+    Vec8f v;
+    for (size_t i = 0; i != 8; ++i)
+        v.v[i] = x + i;
+    return v;
+}
+
+Block<mms::Standalone> genBlock(int id)
+{
+    Block<mms::Standalone> b;
+    b.id = id;
+    for (int i = 0; i != id % 5; ++i)
+        b.vecs.push_back(vec(i));
+    b.name = std::string(id % 7 + 1, 'b');
+    return b;
+}
+
+Doc<mms::Standalone> genDoc(size_t size)
+{
+    Doc<mms::Standalone> d;
+    d.title = "abc";
+    for (size_t i = 0; i != size; ++i) {
+        d.vecs.push_back(vec(i));
+        Line l = { (int) i, "line" };
+        d.lines.push_back(l);
+        d.blocks.push_back(genBlock(i));
+        d.byId[i] = l;
+    }
+    return d;
+}
+
+template<class T>
+bool aligned(const T* p, size_t alignment)
+{
+    return reinterpret_cast<size_t>(p) % alignment == 0;
+}
+
+void checkDoc(const Doc<mms::Mmapped>& d, size_t size)
+{
+    BOOST_CHECK_EQUAL(d.title, "abc");
+    BOOST_REQUIRE_EQUAL(d.vecs.size(), size);
+    BOOST_REQUIRE_EQUAL(d.lines.size(), size);
+    BOOST_REQUIRE_EQUAL(d.blocks.size(), size);
+    BOOST_REQUIRE_EQUAL(d.byId.size(), size);
+    for (size_t i = 0; i != size; ++i) {
+        BOOST_CHECK(aligned(&d.vecs[i], 32));
+        BOOST_CHECK_EQUAL(d.vecs[i].v[7], i + 7.0f);
+        BOOST_CHECK(aligned(&d.lines[i], 64));
+        BOOST_CHECK_EQUAL(d.lines[i].id, (int) i);
+
+        const Block<mms::Mmapped>& b = d.blocks[i];
+        BOOST_CHECK(aligned(&b, 64));
+        BOOST_CHECK_EQUAL(b.id, (int) i);
+        BOOST_REQUIRE_EQUAL(b.vecs.size(), i % 5);
+        for (size_t j = 0; j != b.vecs.size(); ++j) {
+            BOOST_CHECK(aligned(&b.vecs[j], 32));
+            BOOST_CHECK_EQUAL(b.vecs[j].v[0], (float) j);
+        }
+        BOOST_CHECK_EQUAL(b.name, std::string(i % 7 + 1, 'b'));
+
+        mms::map<mms::Mmapped, int, Line>::const_iterator it = d.byId.find(i);
+        BOOST_REQUIRE(it != d.byId.end());
+        BOOST_CHECK(aligned(&it->second, 64));
+        BOOST_CHECK_EQUAL(it->second.id, (int) i);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( over_alignment )
+{
+    size_t sizes[] = { 0, 1, 3, 100 };
+    for (size_t s = 0; s != sizeof(sizes) / sizeof(*sizes); ++s) {
+        Doc<mms::Standalone> doc = genDoc(sizes[s]);
+
+        mms::BufferWriter w;
+        mms::safeWrite(w, doc);
+        BOOST_CHECK_EQUAL(w.size(), mms::safeSerializedSize(doc));
+        checkDoc(w.safeCast< Doc<mms::Mmapped> >(), sizes[s]);
+
+        mms::BufferWriter unsafe;
+        size_t pos = mms::unsafeWrite(unsafe, doc);
+        BOOST_CHECK_EQUAL(unsafe.size(), mms::unsafeSerializedSize(doc));
+        checkDoc(*reinterpret_cast<const Doc<mms::Mmapped>*>(unsafe.data() + pos), sizes[s]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( over_aligned_root )
+{
+    for (int id = 0; id != 10; ++id) {
+        mms::BufferWriter w;
+        mms::string<mms::Standalone> header(std::string(id, 'h'));
+        mms::unsafeWrite(w, header);
+        mms::safeWrite(w, genBlock(id));
+
+        const Block<mms::Mmapped>& b = w.safeCast< Block<mms::Mmapped> >();
+        BOOST_CHECK(aligned(&b, 64));
+        BOOST_CHECK_EQUAL(b.id, id);
+        BOOST_CHECK_EQUAL(b.vecs.size(), (size_t) id % 5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( over_alignment_version )
+{
+    mms::Versions vs;
+    BOOST_CHECK_EQUAL(
+        vs.get<int>(),
+        vs.combine(vs.hash(typeid(int).name()), sizeof(int)));
+    BOOST_CHECK(
+        vs.get<Line>()
+        != vs.combine(vs.hash(typeid(Line).name()), sizeof(Line)));
+    BOOST_CHECK((
+        vs.get< mms::vector<mms::Standalone, Vec8f> >()
+        != vs.get< mms::vector<mms::Standalone, float> >()));
+}
+
+BOOST_AUTO_TEST_CASE( over_alignment_parallel )
+{
+    mms::vector< mms::Standalone, Block<mms::Standalone> > v;
+    for (size_t i = 0; i != 1000; ++i)
+        v.push_back(genBlock(i));
+
+    mms::BufferWriter expected;
+    mms::safeWrite(expected, v);
+
+    mms::BufferWriter w;
+    w.setThreads(4, 16);
+    mms::safeWrite(w, v);
+
+    BOOST_REQUIRE_EQUAL(w.size(), expected.size());
+    BOOST_CHECK(std::equal(w.data(), w.data() + w.size(), expected.data()));
+}
+
+#endif // MMS_USE_CXX11
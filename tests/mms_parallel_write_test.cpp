@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/unordered_map.h>
+
+#include "record_index.h"
+
+#include <sstream>
+
+#if MMS_USE_CXX11
+
+namespace {
+
+template<class T>
+std::string write(const T& t, size_t threads, size_t chunkSize)
+{
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setThreads(threads, chunkSize);
+    mms::safeWrite(w, t);
+    return out.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( parallel_write )
+{
+    size_t sizes[] = { 0, 1, 5, 100, 1000 };
+    size_t chunkSizes[] = { 1, 3, 64 };
+    size_t threads[] = { 2, 3, 8 };
+
+    for (size_t s = 0; s != sizeof(sizes) / sizeof(*sizes); ++s) {
+        Index<mms::Standalone> idx = genIndex(sizes[s]);
+        std::string expected = write(idx, 1, 1);
+
+        for (size_t c = 0; c != sizeof(chunkSizes) / sizeof(*chunkSizes); ++c)
+            for (size_t t = 0; t != sizeof(threads) / sizeof(*threads); ++t)
+                BOOST_CHECK(write(idx, threads[t], chunkSizes[c]) == expected);
+    }
+
+    std::string buf = write(genIndex(1000), 4, 16);
+    const Index<mms::Mmapped>& mm = mms::safeCast< Index<mms::Mmapped> >(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.records.size(), 1000);
+    BOOST_CHECK_EQUAL(mm.records[788].tags[1], std::string(1 + 788 % 7, 'x'));
+    BOOST_CHECK_EQUAL(mm.byName.find("record #3")->second, 993);
+    BOOST_CHECK_EQUAL(mm.byId.find(456)->second, "record #6");
+    BOOST_CHECK_EQUAL(mm.chars[123], 'a' + 123 % 26);
+}
+
+#endif // MMS_USE_CXX11
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+#include "tools.h"
+
+#include <mms/prefetch.h>
+#include <mms/mapped_file.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/unordered_map.h>
+#include <mms/ptr.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+template<class P>
+struct Index {
+    mms::unordered_map<P, int, int> lookup;
+    mms::vector< P, mms::string<P> > payload;
+
+    template<class A> void traverseFields(A a) const { a(lookup)(payload); }
+};
+
+const size_t ITEMS = 5000;
+const size_t PAYLOAD = 2000;
+
+Index<mms::Standalone> makeIndex()
+{
+    Index<mms::Standalone> idx;
+    for (size_t i = 0; i != ITEMS; ++i) {
+        idx.lookup[i] = i;
+        idx.payload.push_back(std::string(PAYLOAD, 'a' + i % 26));
+    }
+    return idx;
+}
+
+struct Progress {
+    std::vector< std::pair<size_t, size_t> >* calls;
+
+    explicit Progress(std::vector< std::pair<size_t, size_t> >& c): calls(&c) {}
+    void operator()(size_t done, size_t total) const { calls->push_back(std::make_pair(done, total)); }
+};
+
+// Fraction of pages in [p, p + size) which are resident
+double resident(const char* p, size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t skew = reinterpret_cast<size_t>(p) % page;
+    std::vector<unsigned char> pages((size + skew + page - 1) / page);
+    BOOST_REQUIRE_EQUAL(mincore(const_cast<char*>(p - skew), size + skew, &pages[0]), 0);
+    size_t count = 0;
+    for (size_t i = 0; i != pages.size(); ++i)
+        count += pages[i] & 1;
+    return double(count) / pages.size();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( prefetch_depth )
+{
+    std::string buf = serialize(makeIndex());
+    const Index<mms::Mmapped>& idx = mms::safeCast< Index<mms::Mmapped> >(buf.data(), buf.size());
+
+    mms::PrefetchStats all = mms::prefetch(idx);
+    BOOST_CHECK(all.bytes >= ITEMS * PAYLOAD);
+    BOOST_CHECK(all.bytes <= buf.size() + 2 * sysconf(_SC_PAGESIZE));
+    BOOST_CHECK(all.ranges >= 1);
+    BOOST_CHECK_EQUAL(all.opaque, 0);
+
+    // Only the hashtable and string headers, not string bodies
+    mms::PrefetchStats top = mms::prefetch(idx, mms::PrefetchPolicy().depth(1));
+    BOOST_CHECK(top.bytes > 0);
+    BOOST_CHECK(top.bytes < ITEMS * PAYLOAD / 10);
+
+    BOOST_CHECK_EQUAL(mms::prefetch(idx, mms::PrefetchPolicy().depth(0)).bytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE( prefetch_extents )
+{
+    std::string buf = serialize(makeIndex());
+    const Index<mms::Mmapped>& idx = mms::safeCast< Index<mms::Mmapped> >(buf.data(), buf.size());
+
+    mms::impl::PrefetchExtent e(2);
+    mms::impl::collectPointees(e, idx);
+    typedef std::vector<mms::impl::PrefetchExtent::Range> Ranges;
+    Ranges ranges = e.ranges();
+    for (Ranges::const_iterator i = ranges.begin(); i != ranges.end(); ++i) {
+        BOOST_CHECK(i->begin < i->end);
+        BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(i->begin) % e.pageSize(), 0);
+        if (i + 1 != ranges.end())
+            BOOST_CHECK(i->end < (i + 1)->begin);
+    }
+
+    // Everything reachable is covered
+    for (size_t i = 0; i < ITEMS; i += 97) {
+        const char* s = idx.payload[i].c_str();
+        bool covered = false;
+        for (Ranges::const_iterator r = ranges.begin(); r != ranges.end(); ++r)
+            covered |= (s >= r->begin && s + PAYLOAD <= r->end);
+        BOOST_CHECK(covered);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( prefetch_progress )
+{
+    std::string buf = serialize(makeIndex());
+    const Index<mms::Mmapped>& idx = mms::safeCast< Index<mms::Mmapped> >(buf.data(), buf.size());
+
+    for (size_t threads = 1; threads <= 4; threads += 3) {
+        std::vector< std::pair<size_t, size_t> > calls;
+        mms::PrefetchStats stats = mms::prefetch(idx,
+            mms::PrefetchPolicy().chunkSize(64 << 10).threads(threads), Progress(calls));
+        BOOST_REQUIRE(calls.size() > 1);
+        for (size_t i = 0; i != calls.size(); ++i) {
+            BOOST_CHECK_EQUAL(calls[i].second, stats.bytes);
+            if (i)
+                BOOST_CHECK(calls[i].first > calls[i - 1].first);
+        }
+        BOOST_CHECK_EQUAL(calls.back().first, stats.bytes);
+    }
+
+    std::vector< std::pair<size_t, size_t> > calls;
+    mms::prefetch(idx, mms::PrefetchPolicy().method(mms::PrefetchAdvise), Progress(calls));
+    BOOST_CHECK(!calls.empty());
+}
+
+namespace {
+
+template<class P>
+struct WithPtr {
+    mms::vector<P, int> ints;
+    mms::shared_ptr< P, OuterPtr<P> > shared;
+
+    template<class A> void traverseFields(A a) const { a(ints)(shared); }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( prefetch_opaque )
+{
+    WithPtr<mms::Standalone> w;
+    w.ints.assign(100, 1);
+    w.shared = new OuterPtr<mms::Standalone>(10);
+    std::string buf = serialize(w);
+    mms::PrefetchStats stats = mms::prefetch(
+        mms::safeCast< WithPtr<mms::Mmapped> >(buf.data(), buf.size()));
+    BOOST_CHECK_EQUAL(stats.opaque, 1);
+    BOOST_CHECK(stats.bytes > 0);
+}
+
+BOOST_AUTO_TEST_CASE( prefetch_resident )
+{
+    TempFile f;
+    {
+        std::ofstream out(f.path().c_str());
+        mms::safeWrite(out, makeIndex());
+    }
+    {
+        int fd = open(f.path().c_str(), O_RDONLY);
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    // No readahead, so only what is touched becomes resident
+    mms::MappedFile< Index<mms::Mmapped> > m(f.path(),
+        mms::MapPolicy().advise(mms::MapPolicy::Random));
+    bool cold = resident(m.data(), m.size()) < 0.5;
+
+    mms::prefetch(*m, mms::PrefetchPolicy().depth(1));
+    if (cold)
+        BOOST_CHECK(resident(m->payload[ITEMS / 2].c_str(), PAYLOAD) < 1);
+    BOOST_CHECK_EQUAL(resident(reinterpret_cast<const char*>(m->payload.begin()),
+        ITEMS * sizeof(mms::string<mms::Mmapped>)), 1);
+
+    mms::prefetch(*m, mms::PrefetchPolicy().threads(2));
+    BOOST_CHECK_EQUAL(resident(m.data(), m.size()), 1);
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "tools.h"
+
+#include <mms/residency.h>
+#include <mms/mapped_file.h>
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+template<class P>
+struct Index {
+    mms::map< P, int, mms::string<P> > lookup;
+    mms::vector< P, mms::string<P> > payload;
+    mms::vector<P, int> numbers;
+
+    template<class A> void traverseFields(A a) const
+    {
+        a(mms::field("lookup", lookup))(mms::field("payload", payload))(numbers);
+    }
+};
+
+const size_t ITEMS = 5000;
+const size_t PAYLOAD = 2000;
+
+Index<mms::Standalone> makeIndex()
+{
+    Index<mms::Standalone> idx;
+    for (size_t i = 0; i != ITEMS; ++i) {
+        std::ostringstream s;
+        s << "key " << i;
+        idx.lookup[i] = s.str();
+        idx.payload.push_back(std::string(PAYLOAD, 'a' + i % 26));
+        idx.numbers.push_back(i);
+    }
+    return idx;
+}
+
+std::map<std::string, mms::ResidencyRow> byPath(const std::vector<mms::ResidencyRow>& rows)
+{
+    std::map<std::string, mms::ResidencyRow> result;
+    for (size_t i = 0; i != rows.size(); ++i)
+        result[rows[i].path] = rows[i];
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( residency_paths )
+{
+    std::ostringstream out;
+    mms::safeWrite(out, makeIndex());
+    std::string buf = out.str();
+    const Index<mms::Mmapped>& idx = mms::safeCast< Index<mms::Mmapped> >(buf.data(), buf.size());
+
+    mms::ResidencyMap map(idx);
+    std::vector<mms::ResidencyRow> rows = map.rows();
+    std::map<std::string, mms::ResidencyRow> paths = byPath(rows);
+
+    BOOST_CHECK(paths.count("(root)"));
+    BOOST_CHECK(paths.count("lookup"));
+    BOOST_CHECK(paths.count("lookup[].second"));
+    BOOST_CHECK(paths.count("payload"));
+    BOOST_CHECK(paths.count("payload[]"));
+    BOOST_CHECK(paths.count("#2"));
+    BOOST_CHECK_EQUAL(rows.back().path, "(total)");
+
+    BOOST_CHECK_EQUAL(paths["(root)"].bytes, sizeof(Index<mms::Mmapped>));
+    BOOST_CHECK_EQUAL(paths["payload"].bytes, ITEMS * sizeof(mms::string<mms::Mmapped>));
+    BOOST_CHECK_EQUAL(paths["payload[]"].bytes, ITEMS * (PAYLOAD + 1));
+    BOOST_CHECK_EQUAL(paths["#2"].bytes, ITEMS * sizeof(int));
+    BOOST_CHECK(paths["payload[]"].pages >= ITEMS * PAYLOAD / sysconf(_SC_PAGESIZE));
+
+    // A std::string is all in memory
+    for (size_t i = 0; i != rows.size(); ++i)
+        BOOST_CHECK_EQUAL(rows[i].residentPages, rows[i].pages);
+
+    std::vector<std::string> owners = map.owners(idx.payload[ITEMS / 2].c_str() + PAYLOAD / 2);
+    BOOST_CHECK(std::find(owners.begin(), owners.end(), "payload[]") != owners.end());
+    BOOST_CHECK(std::find(owners.begin(), owners.end(), "#2") == owners.end());
+
+    BOOST_CHECK_THROW(map.startSample(), std::logic_error);
+
+    std::ostringstream table;
+    map.print(table);
+    BOOST_CHECK(table.str().find("payload[]") != std::string::npos);
+    BOOST_CHECK(table.str().find("accessed") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( residency_sampling )
+{
+    TempFile f;
+    {
+        std::ofstream out(f.path().c_str());
+        mms::safeWrite(out, makeIndex());
+    }
+    mms::MappedFile< Index<mms::Mmapped> > m(f.path(), mms::MapPolicy().populate());
+    mms::ResidencyMap map(m);
+
+    std::map<std::string, mms::ResidencyRow> paths = byPath(map.rows());
+    BOOST_CHECK_EQUAL(paths["(total)"].pages, (m.size() + sysconf(_SC_PAGESIZE) - 1) / sysconf(_SC_PAGESIZE));
+    BOOST_CHECK_EQUAL(paths["(total)"].residentPages, paths["(total)"].pages);
+
+    // Look keys up, never touching the payload
+    size_t sum = 0;
+    for (size_t round = 0; round != 3; ++round) {
+        map.startSample();
+        for (size_t i = 0; i < ITEMS; i += 7)
+            sum += m->lookup[i].size();
+        map.endSample();
+    }
+    BOOST_CHECK(sum > 0);
+    BOOST_CHECK_EQUAL(map.samples(), 3);
+
+    paths = byPath(map.rows());
+    const mms::ResidencyRow& lookup = paths["lookup"];
+    const mms::ResidencyRow& payload = paths["payload[]"];
+    BOOST_CHECK(lookup.accessedPages > 0);
+    BOOST_CHECK(lookup.accesses >= lookup.accessedPages);
+    BOOST_CHECK(lookup.accesses <= 3 * lookup.pages);
+    BOOST_CHECK(payload.accessedPages < payload.pages / 2);
+    // Unmapping pages does not evict them
+    BOOST_CHECK_EQUAL(paths["(total)"].residentPages, paths["(total)"].pages);
+
+    std::ostringstream table;
+    map.print(table);
+    BOOST_CHECK(table.str().find("accessed") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( residency_locked_mapping )
+{
+    TempFile f;
+    {
+        std::ofstream out(f.path().c_str());
+        mms::safeWrite(out, makeIndex());
+    }
+    size_t page = sysconf(_SC_PAGESIZE);
+    mms::MappedFile< Index<mms::Mmapped> > m(f.path(), mms::MapPolicy().populate().lock(8 * page));
+    mms::ResidencyMap map(m);
+
+    size_t sum = 0;
+    for (size_t round = 0; round != 2; ++round) {
+        map.startSample();
+        for (size_t i = 0; i < ITEMS; i += 7)
+            sum += m->lookup[i].size();
+        map.endSample();
+    }
+    BOOST_CHECK(sum > 0);
+    BOOST_CHECK_EQUAL(map.lockedPages(), 8u);
+
+    // Locked pages are never seen accessed, the rest are sampled as usual
+    std::map<std::string, mms::ResidencyRow> paths = byPath(map.rows());
+    const mms::ResidencyRow& total = paths["(total)"];
+    BOOST_CHECK(total.accessedPages > 0);
+    BOOST_CHECK(total.accessedPages <= total.pages - 8);
+    BOOST_CHECK_EQUAL(total.residentPages, total.pages);
+}
+
+BOOST_AUTO_TEST_CASE( residency_private_mapping )
+{
+    TempFile f;
+    {
+        std::ofstream out(f.path().c_str());
+        mms::safeWrite(out, makeIndex());
+    }
+    mms::MappedFile< Index<mms::Mmapped> > m(f.path(), mms::MapPolicy().privateWritable());
+    mms::ResidencyMap map(m);
+    BOOST_CHECK_THROW(map.startSample(), std::logic_error);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/set.h>
+
+#include "tools.h"
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Record {
+    int id;
+    mms::string<P> name;
+    mms::vector<P, int> values;
+
+    template<class A> void traverseFields(A a) const { a(id)(name)(values); }
+};
+
+template<class P>
+struct Snapshot {
+    mms::string<P> title;
+    mms::vector< P, Record<P> > records;
+    mms::map< P, mms::string<P>, mms::vector<P, double> > series;
+    mms::set< P, mms::string<P> > tags;
+
+    template<class A> void traverseFields(A a) const { a(title)(records)(series)(tags); }
+};
+
+Snapshot<mms::Standalone> genSnapshot(size_t size)
+{
+    Snapshot<mms::Standalone> s;
+    s.title = "snapshot";
+    for (size_t i = 0; i != size; ++i) {
+        std::ostringstream name;
+        name << "record #" << i;
+        Record<mms::Standalone> r;
+        r.id = i;
+        r.name = name.str();
+        r.values.assign(i % 5, i);
+        s.records.push_back(r);
+        s.series[name.str()].assign(i % 3, i * 0.5);
+        s.tags.insert(name.str());
+    }
+    return s;
+}
+
+void checkSnapshot(const Snapshot<mms::Mmapped>& s, size_t size)
+{
+    BOOST_CHECK_EQUAL(s.title, "snapshot");
+    BOOST_REQUIRE_EQUAL(s.records.size(), size);
+    BOOST_REQUIRE_EQUAL(s.series.size(), size);
+    BOOST_REQUIRE_EQUAL(s.tags.size(), size);
+    for (size_t i = 0; i != size; ++i) {
+        std::ostringstream name;
+        name << "record #" << i;
+        const Record<mms::Mmapped>& r = s.records[i];
+        BOOST_CHECK_EQUAL(r.id, (int) i);
+        BOOST_CHECK_EQUAL(r.name, name.str());
+        BOOST_REQUIRE_EQUAL(r.values.size(), i % 5);
+        for (size_t j = 0; j != r.values.size(); ++j)
+            BOOST_CHECK_EQUAL(r.values[j], (int) i);
+        BOOST_CHECK_EQUAL(s.series[name.str()].size(), i % 3);
+        BOOST_CHECK(s.tags.find(name.str()) != s.tags.end());
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( rewrite_mmapped )
+{
+    std::string buf = serialize(genSnapshot(100));
+    const Snapshot<mms::Mmapped>& s = mms::cast< Snapshot<mms::Mmapped> >(buf.data(), buf.size());
+
+    // Whole containers are copied as they are, so are their paddings
+    std::string copy = serialize(s);
+    BOOST_CHECK(copy == buf);
+    checkSnapshot(mms::cast< Snapshot<mms::Mmapped> >(copy.data(), copy.size()), 100);
+}
+
+BOOST_AUTO_TEST_CASE( rewrite_relocated )
+{
+    std::string buf = serialize(genSnapshot(100));
+    const Snapshot<mms::Mmapped>& s = mms::cast< Snapshot<mms::Mmapped> >(buf.data(), buf.size());
+
+    // Parts of old data mixed with new
+    mms::BufferWriter w;
+    mms::impl::addZeroes(w, 24);
+    mms::vector< mms::Standalone, mms::vector< mms::Mmapped, Record<mms::Mmapped> > > v;
+    v.push_back(s.records);
+    v.push_back(mms::vector< mms::Mmapped, Record<mms::Mmapped> >());
+    v.push_back(s.records);
+    size_t pos = mms::write(w, v);
+
+    typedef mms::vector< mms::Mmapped, mms::vector< mms::Mmapped, Record<mms::Mmapped> > > Mmapped;
+    const Mmapped& mm = *reinterpret_cast<const Mmapped*>(w.data() + pos);
+    BOOST_REQUIRE_EQUAL(mm.size(), 3u);
+    BOOST_CHECK(mm[1].empty());
+    BOOST_REQUIRE_EQUAL(mm[2].size(), 100u);
+    BOOST_CHECK_EQUAL(mm[2][42].name, "record #42");
+    BOOST_CHECK_EQUAL(mm[0][99].values[3], 99);
+    BOOST_CHECK_EQUAL(mms::serializedSize(v), w.size() - 24);
+}
+
+BOOST_AUTO_TEST_CASE( rewrite_scattered )
+{
+    // With interning, strings of `tags' refer to ones written
+    // as a part of `records', so the set cannot be copied as a whole
+    Snapshot<mms::Standalone> src = genSnapshot(1000);
+    mms::BufferWriter w;
+    w.setStringInterning(true);
+    mms::write(w, src);
+    const Snapshot<mms::Mmapped>& s = w.safeCast< Snapshot<mms::Mmapped> >();
+
+    std::string tags = serialize(s.tags);
+    BOOST_CHECK(tags.size() < w.size() / 2);
+    BOOST_CHECK(tags == serialize(src.tags));
+
+    std::string copy = serialize(s);
+    checkSnapshot(mms::cast< Snapshot<mms::Mmapped> >(copy.data(), copy.size()), 1000);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+
+#include <mms/writer.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/ptr.h>
+#include <mms/transient.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Record {
+    int i;
+    mms::string<P> str;
+    mms::map<P, mms::string<P>, mms::vector<P, int> > map;
+
+    template<class A> void traverseFields(A a) const { a(i)(str)(map); }
+};
+
+template<class P>
+struct OddTransient {
+    mms::transient<P, char> c;
+    mms::vector<P, double> v;
+
+    template<class A> void traverseFields(A a) const { a(c)(v); }
+};
+
+template<class T>
+void checkSize(const T& t)
+{
+    std::stringstream safe, unsafe;
+    mms::safeWrite(safe, t);
+    mms::unsafeWrite(unsafe, t);
+    BOOST_CHECK_EQUAL(mms::safeSerializedSize(t), safe.str().size());
+    BOOST_CHECK_EQUAL(mms::serializedSize(t), safe.str().size());
+    BOOST_CHECK_EQUAL(mms::unsafeSerializedSize(t), unsafe.str().size());
+}
+
+typedef mms::shared_ptr< mms::Standalone, OuterPtr<mms::Standalone> > Ptr;
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( serialized_size )
+{
+    checkSize(42);
+    checkSize(mms::string<mms::Standalone>("hello, world"));
+
+    mms::vector<mms::Standalone, int> v;
+    checkSize(v);
+    for (int i = 0; i != 1000; ++i)
+        v.push_back(i);
+    checkSize(v);
+
+    Record<mms::Standalone> r;
+    r.i = 1;
+    r.str = "record";
+    for (int i = 0; i != 100; ++i)
+        r.map[std::string(i % 10 + 1, 'a' + i % 26)].assign(i % 3, i);
+    checkSize(r);
+}
+
+BOOST_AUTO_TEST_CASE( serialized_size_layout )
+{
+    checkSize(Ptr(new OuterPtr<mms::Standalone>(100)));
+
+    OddTransient<mms::Standalone> t;
+    t.v.assign(10, 1.5);
+    checkSize(t);
+}
+
+BOOST_AUTO_TEST_CASE( serialized_size_keeps_pointees )
+{
+    Ptr p(new OuterPtr<mms::Standalone>(10));
+    mms::shared_ptr< mms::Standalone, InnerPtr<mms::Standalone> > inner = p->inners[3];
+
+    std::stringstream expected;
+    {
+        mms::Writer w(expected);
+        mms::write(w, p);
+        mms::write(w, inner);
+    }
+
+    // Inner pointee is already written when its size is counted,
+    // and the second write must still refer to it rather than
+    // write it again.
+    std::stringstream actual;
+    {
+        mms::Writer w(actual);
+        mms::write(w, p);
+        BOOST_CHECK(mms::serializedSize(inner) > sizeof(size_t));
+        size_t pos;
+        BOOST_CHECK(w.pointees().written(inner.get(), pos));
+        mms::write(w, inner);
+    }
+    BOOST_CHECK(actual.str() == expected.str());
+}
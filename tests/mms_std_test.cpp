@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/std.h>
+#include <mms/cast.h>
+
+#include "tools.h"
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Item {
+    int id;
+    typename mms::vector< P, mms::string<P> > tags;
+
+    template<class A> void traverseFields(A a) const { a(id)(tags); }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( std_vector_of_strings )
+{
+    std::vector<std::string> v;
+    mms::vector< mms::Standalone, mms::string<mms::Standalone> > mv;
+    for (size_t i = 0; i != 100; ++i) {
+        std::ostringstream s;
+        s << "string #" << i;
+        v.push_back(s.str());
+        mv.push_back(s.str());
+    }
+
+    std::string buf = serialize(v);
+    BOOST_CHECK(buf == serialize(mv));
+    BOOST_CHECK_EQUAL(mms::serializedSize(v), buf.size());
+
+    typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > MmappedVector;
+    const MmappedVector& mm = mms::cast<MmappedVector>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    for (size_t i = 0; i != v.size(); ++i)
+        BOOST_CHECK_EQUAL(mm[i], v[i]);
+}
+
+BOOST_AUTO_TEST_CASE( std_map_of_vectors )
+{
+    std::map< std::string, std::vector<int> > m;
+    mms::map< mms::Standalone, mms::string<mms::Standalone>, mms::vector<mms::Standalone, int> > mm;
+    for (int i = 0; i != 100; ++i) {
+        std::ostringstream s;
+        s << "key" << i;
+        std::vector<int> v(i % 7, i);
+        m[s.str()] = v;
+        mm[s.str()] = v;
+    }
+
+    std::string buf = serialize(m);
+    BOOST_CHECK(buf == serialize(mm));
+
+    typedef mms::map< mms::Mmapped, mms::string<mms::Mmapped>, mms::vector<mms::Mmapped, int> > MmappedMap;
+    const MmappedMap& mmapped = mms::cast<MmappedMap>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mmapped.size(), m.size());
+    BOOST_CHECK_EQUAL(mmapped["key13"].size(), 6u);
+    BOOST_CHECK_EQUAL(mmapped["key13"][5], 13);
+}
+
+BOOST_AUTO_TEST_CASE( std_sequences )
+{
+    std::vector<bool> bools;
+    std::deque<double> doubles;
+    std::list< std::pair<int, std::string> > pairs;
+    std::set< std::string, std::greater<std::string> > strings;
+    for (int i = 0; i != 50; ++i) {
+        bools.push_back(i % 3 == 0);
+        doubles.push_back(i * 0.25);
+        pairs.push_back(std::make_pair(i, std::string(i % 5, 'x')));
+        strings.insert(std::string(i, 'y'));
+    }
+
+    std::string buf = serialize(bools);
+    BOOST_CHECK(buf == serialize(mms::vector<mms::Standalone, bool>(bools)));
+
+    buf = serialize(doubles);
+    BOOST_CHECK(buf == serialize(mms::vector<mms::Standalone, double>(doubles.begin(), doubles.end())));
+
+    buf = serialize(pairs);
+    typedef mms::vector< mms::Mmapped, std::pair< int, mms::string<mms::Mmapped> > > MmappedPairs;
+    const MmappedPairs& mp = mms::cast<MmappedPairs>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mp.size(), pairs.size());
+    BOOST_CHECK_EQUAL(mp[7].first, 7);
+    BOOST_CHECK_EQUAL(mp[7].second, "xx");
+
+    buf = serialize(strings);
+    typedef mms::set<mms::Mmapped, mms::string<mms::Mmapped>, std::greater> MmappedSet;
+    const MmappedSet& ms = mms::cast<MmappedSet>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(ms.size(), strings.size());
+    BOOST_CHECK_EQUAL(ms.begin()->size(), 49u);
+    BOOST_CHECK(ms.find("yyy") != ms.end());
+}
+
+BOOST_AUTO_TEST_CASE( std_containers_as_elements )
+{
+    // std containers inside mms ones and vice versa
+    std::vector< Item<mms::Standalone> > items(10);
+    for (int i = 0; i != 10; ++i) {
+        items[i].id = i;
+        items[i].tags.push_back("tag");
+    }
+    mms::vector< mms::Standalone, std::vector< Item<mms::Standalone> > > nested;
+    nested.push_back(items);
+    nested.push_back(std::vector< Item<mms::Standalone> >());
+
+    std::string buf = serialize(nested);
+    typedef mms::vector< mms::Mmapped, mms::vector< mms::Mmapped, Item<mms::Mmapped> > > Mmapped;
+    const Mmapped& mm = mms::cast<Mmapped>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), 2u);
+    BOOST_REQUIRE_EQUAL(mm[0].size(), 10u);
+    BOOST_CHECK(mm[1].empty());
+    BOOST_CHECK_EQUAL(mm[0][9].id, 9);
+    BOOST_CHECK_EQUAL(mm[0][9].tags[0], "tag");
+}
+
+BOOST_AUTO_TEST_CASE( std_range )
+{
+    std::vector<int> v;
+    for (int i = 0; i != 100; ++i)
+        v.push_back(i * i);
+
+    std::string buf = serialize(mms::range(v.begin() + 10, v.begin() + 20));
+    BOOST_CHECK(buf == serialize(std::vector<int>(v.begin() + 10, v.begin() + 20)));
+
+    std::list<std::string> l(3, "abc");
+    buf = serialize(mms::range(l));
+    BOOST_CHECK(buf == serialize(std::vector<std::string>(3, "abc")));
+}
+
+#if MMS_USE_CXX11
+
+BOOST_AUTO_TEST_CASE( std_array )
+{
+    std::array<int, 4> ints = {{ 1, 2, 3, 4 }};
+    std::string buf = serialize(ints);
+    const std::array<int, 4>& mi = mms::cast< std::array<int, 4> >(buf.data(), buf.size());
+    BOOST_CHECK(mi == ints);
+
+    std::vector< std::array<std::string, 2> > v(5);
+    for (size_t i = 0; i != v.size(); ++i) {
+        v[i][0] = "first";
+        v[i][1] = std::string(i, 's');
+    }
+    buf = serialize(v);
+    typedef mms::vector< mms::Mmapped, std::array<mms::string<mms::Mmapped>, 2> > Mmapped;
+    const Mmapped& mm = mms::cast<Mmapped>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    BOOST_CHECK_EQUAL(mm[4][0], "first");
+    BOOST_CHECK_EQUAL(mm[4][1], "ssss");
+}
+
+#endif // MMS_USE_CXX11
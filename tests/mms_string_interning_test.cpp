@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <mms/writer.h>
+#include <mms/buffer_writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/ptr.h>
+
+#include "tools.h"
+
+#include <set>
+#include <sstream>
+
+namespace {
+
+typedef mms::vector< mms::Standalone, mms::string<mms::Standalone> > Strings;
+typedef mms::vector< mms::Mmapped, mms::string<mms::Mmapped> > MmappedStrings;
+
+// genStrings() repeats itself every PERIOD strings
+const size_t PERIOD = 17 * 26;
+
+size_t distinctCount(const Strings& v)
+{
+    return std::set<std::string>(v.begin(), v.end()).size();
+}
+
+template<class P>
+struct Named: public mms::Pointee {
+    mms::string<P> name;
+
+    Named() {}
+    explicit Named(const char* n): name(n) {}
+    template<class A> void traverseFields(A a) const { a(name); }
+};
+
+template<class P>
+struct Catalog {
+    mms::string<P> title;
+    mms::ptr< P, Named<P> > first;
+    mms::vector< P, mms::string<P> > tags;
+    mms::ptr< P, Named<P> > second;
+
+    template<class A> void traverseFields(A a) const { a(title)(first)(tags)(second); }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( string_interning )
+{
+    Strings v = genStrings(1000);
+
+    std::ostringstream plain;
+    mms::safeWrite(plain, v);
+
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setStringInterning(true);
+    mms::safeWrite(w, v);
+    BOOST_REQUIRE(w.stringPool());
+    size_t distinct = distinctCount(v);
+    BOOST_CHECK_EQUAL(w.stringPool()->size(), distinct);
+    BOOST_CHECK_EQUAL(w.stringPool()->hits(), v.size() - distinct);
+    BOOST_CHECK(out.str().size() < plain.str().size());
+
+    std::string buf = out.str();
+    const MmappedStrings& mm = mms::safeCast<MmappedStrings>(buf.data(), buf.size());
+    BOOST_REQUIRE_EQUAL(mm.size(), v.size());
+    for (size_t i = 0; i != v.size(); ++i)
+        BOOST_CHECK_EQUAL(mm[i], v[i]);
+    BOOST_CHECK(mm[1].c_str() == mm[1 + PERIOD].c_str());
+    BOOST_CHECK(mm[1].c_str() != mm[2].c_str());
+
+    w.setStringInterning(false);
+    BOOST_CHECK(!w.stringPool());
+}
+
+BOOST_AUTO_TEST_CASE( string_interning_across_writes )
+{
+    mms::BufferWriter w;
+    w.setStringInterning(true);
+    size_t first = mms::unsafeWrite(w, mms::string<mms::Standalone>("cc"));
+    size_t second = mms::unsafeWrite(w, genStrings(10));
+
+    const mms::string<mms::Mmapped>& s =
+        *reinterpret_cast<const mms::string<mms::Mmapped>*>(w.data() + first);
+    const MmappedStrings& v = *reinterpret_cast<const MmappedStrings*>(w.data() + second);
+    BOOST_CHECK_EQUAL(v[2], "cc");
+    BOOST_CHECK(v[2].c_str() == s.c_str());
+
+    // clear() starts from scratch, so strings are written again
+    w.clear();
+    mms::safeWrite(w, genStrings(2 * PERIOD));
+    BOOST_CHECK_EQUAL(w.stringPool()->size(), distinctCount(genStrings(2 * PERIOD)));
+    BOOST_CHECK_EQUAL(
+        w.safeCast<MmappedStrings>()[2].c_str(),
+        w.safeCast<MmappedStrings>()[2 + PERIOD].c_str());
+}
+
+BOOST_AUTO_TEST_CASE( string_interning_with_layout )
+{
+    Catalog<mms::Standalone> c;
+    c.title = "eeee";
+    c.first = new Named<mms::Standalone>("Acme");
+    c.tags = genStrings(20);
+    c.second = new Named<mms::Standalone>("b");
+
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setStringInterning(true);
+    size_t headerPos = mms::unsafeWrite(w, mms::string<mms::Standalone>("Acme"));
+    size_t pos = mms::unsafeWrite(w, c);
+
+    std::string buf = out.str();
+    const mms::string<mms::Mmapped>& header =
+        *reinterpret_cast<const mms::string<mms::Mmapped>*>(buf.data() + headerPos);
+    const Catalog<mms::Mmapped>& mm = *reinterpret_cast<const Catalog<mms::Mmapped>*>(buf.data() + pos);
+    BOOST_CHECK_EQUAL(mm.title, "eeee");
+    BOOST_CHECK_EQUAL(mm.first->name, "Acme");
+    BOOST_CHECK_EQUAL(mm.second->name, "b");
+    BOOST_CHECK(mm.first->name.c_str() == header.c_str());
+    BOOST_REQUIRE_EQUAL(mm.tags.size(), 20u);
+    for (size_t i = 0; i != mm.tags.size(); ++i)
+        BOOST_CHECK_EQUAL(mm.tags[i], c.tags[i]);
+    BOOST_CHECK(mm.tags[4].c_str() == mm.title.c_str());
+    BOOST_CHECK(mm.tags[1].c_str() == mm.second->name.c_str());
+
+    delete c.first.get();
+    delete c.second.get();
+}
+
+#if MMS_USE_CXX11
+BOOST_AUTO_TEST_CASE( string_interning_disables_parallel_write )
+{
+    Strings v = genStrings(10000);
+
+    std::ostringstream expected;
+    {
+        mms::Writer w(expected);
+        w.setStringInterning(true);
+        mms::safeWrite(w, v);
+    }
+
+    std::ostringstream out;
+    mms::Writer w(out);
+    w.setStringInterning(true);
+    w.setThreads(4, 100);
+    mms::safeWrite(w, v);
+    BOOST_CHECK(out.str() == expected.str());
+}
+#endif
@@ -107,3 +107,31 @@ BOOST_AUTO_TEST_CASE( pod_test )
     }
 }
 
+
+BOOST_AUTO_TEST_CASE( offset_stack_test )
+{
+    typedef TraverseSimple<
+        mms::vector<mms::Standalone, mms::string<mms::Standalone> >,
+        mms::map<mms::Standalone, int, mms::string<mms::Standalone> >,
+        int
+    > Item;
+    mms::vector<mms::Standalone, Item> v(1000);
+    for (size_t i = 0; i != v.size(); ++i) {
+        v[i].v1.assign(i % 5, "str");
+        v[i].v2[i] = "map";
+    }
+
+    std::stringstream out;
+    mms::Writer w(out);
+    mms::write(w, v);
+    BOOST_CHECK(w.offsetStack().empty());
+
+    // Offsets of the outer vector elements need to be kept
+    // for the field pass, but not those of nested containers.
+    size_t capacity = w.offsetStack().capacity();
+    BOOST_CHECK(capacity < 4 * v.size());
+
+    mms::write(w, v);
+    BOOST_CHECK(w.offsetStack().empty());
+    BOOST_CHECK_EQUAL(w.offsetStack().capacity(), capacity);
+}
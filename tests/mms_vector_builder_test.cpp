@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "test_config.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "ptr_recursive.h"
+
+#include <mms/vector_builder.h>
+#include <mms/writer.h>
+#include <mms/cast.h>
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+
+#include <sstream>
+
+namespace {
+
+template<class P>
+struct Item {
+    int id;
+    mms::string<P> name;
+    mms::vector<P, int> refs;
+    mms::map<P, int, mms::string<P> > attrs;
+
+    template<class A> void traverseFields(A a) const { a(id)(name)(refs)(attrs); }
+};
+
+template<class P>
+struct Doc {
+    int id;
+    mms::vector<P, Item<P> > items;
+    mms::string<P> title;
+
+    template<class A> void traverseFields(A a) const { a(id)(items)(title); }
+};
+
+struct DocWriter {
+    typedef Doc<mms::Mmapped> MmappedType;
+
+    int id;
+    mms::BuiltVector< Item<mms::Standalone> > items;
+    mms::string<mms::Standalone> title;
+
+    template<class A> void traverseFields(A a) const { a(id)(items)(title); }
+};
+
+Item<mms::Standalone> genItem(size_t i)
+{
+    Item<mms::Standalone> item;
+    item.id = i;
+    item.name = std::string(i % 13, 'a' + i % 26);
+    item.refs.assign(i % 5, i);
+    for (size_t j = 0; j != i % 4; ++j)
+        item.attrs[j] = std::string(j + 1, 'z');
+    return item;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( vector_builder )
+{
+    size_t sizes[] = { 0, 1, 10, 100000 };
+    for (size_t s = 0; s != sizeof(sizes) / sizeof(*sizes); ++s) {
+        mms::vector< mms::Standalone, Item<mms::Standalone> > v;
+        std::stringstream actual;
+        mms::Writer w(actual);
+        mms::VectorBuilder< Item<mms::Standalone> > builder(w);
+        for (size_t i = 0; i != sizes[s]; ++i) {
+            Item<mms::Standalone> item = genItem(i);
+            builder.push_back(item);
+            v.push_back(item);
+        }
+        BOOST_CHECK_EQUAL(builder.size(), sizes[s]);
+        mms::safeWrite(w, builder.finish());
+
+        std::stringstream expected;
+        mms::safeWrite(expected, v);
+        BOOST_CHECK(actual.str() == expected.str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( vector_builder_trivial )
+{
+    mms::vector<mms::Standalone, int> v;
+    std::stringstream actual;
+    mms::Writer w(actual);
+    mms::string<mms::Standalone>("unaligned").writeData(w);
+
+    mms::VectorBuilder<int> builder(w);
+    for (int i = 0; i != 1000; ++i) {
+        builder.push_back(i * 3);
+        v.push_back(i * 3);
+    }
+    mms::safeWrite(w, builder.finish());
+
+    std::stringstream expected;
+    mms::Writer ew(expected);
+    mms::string<mms::Standalone>("unaligned").writeData(ew);
+    mms::safeWrite(ew, v);
+    BOOST_CHECK(actual.str() == expected.str());
+}
+
+BOOST_AUTO_TEST_CASE( vector_builder_trivial_body_alignment )
+{
+    mms::vector<mms::Standalone, int> v;
+    std::stringstream actual;
+    mms::Writer w(actual);
+    w.setBodyAlignment(4096, 4096);
+    mms::string<mms::Standalone>("unaligned").writeData(w);
+
+    mms::VectorBuilder<int> builder(w);
+    for (int i = 0; i != 10000; ++i) {
+        builder.push_back(i);
+        v.push_back(i);
+    }
+    mms::BuiltVector<int> built = builder.finish();
+    BOOST_REQUIRE_EQUAL(w.bodyExtents().size(), 1u);
+    BOOST_CHECK_EQUAL(w.bodyExtents()[0].pos % 4096, 0u);
+    mms::safeWrite(w, built);
+
+    std::stringstream expected;
+    mms::Writer ew(expected);
+    ew.setBodyAlignment(4096, 4096);
+    mms::string<mms::Standalone>("unaligned").writeData(ew);
+    mms::safeWrite(ew, v);
+    BOOST_CHECK(actual.str() == expected.str());
+}
+
+BOOST_AUTO_TEST_CASE( vector_builder_field )
+{
+    Doc<mms::Standalone> doc;
+    doc.id = 42;
+    doc.title = "title";
+
+    std::stringstream actual;
+    mms::Writer w(actual);
+    DocWriter dw;
+    dw.id = 42;
+    dw.title = "title";
+    {
+        mms::VectorBuilder< Item<mms::Standalone> > builder(w);
+        for (size_t i = 0; i != 1000; ++i) {
+            builder.push_back(genItem(i));
+            doc.items.push_back(genItem(i));
+        }
+        dw.items = builder.finish();
+    }
+    mms::safeWrite(w, dw);
+
+    std::stringstream expected;
+    mms::safeWrite(expected, doc);
+    BOOST_CHECK(actual.str() == expected.str());
+
+    std::string buf = actual.str();
+    const Doc<mms::Mmapped>& mm = mms::safeCast< Doc<mms::Mmapped> >(buf.data(), buf.size());
+    BOOST_CHECK_EQUAL(mm.id, 42);
+    BOOST_CHECK_EQUAL(mm.title, "title");
+    BOOST_REQUIRE_EQUAL(mm.items.size(), 1000);
+    BOOST_CHECK_EQUAL(mm.items[123].id, 123);
+    BOOST_CHECK_EQUAL(mm.items[123].name, std::string(123 % 13, 'a' + 123 % 26));
+    BOOST_CHECK_EQUAL(mm.items[123].attrs.find(2)->second, "zzz");
+}
+
+BOOST_AUTO_TEST_CASE( vector_builder_needs_layout )
+{
+    typedef mms::shared_ptr< mms::Standalone, OuterPtr<mms::Standalone> > Ptr;
+    std::stringstream out;
+    mms::Writer w(out);
+    BOOST_CHECK_THROW(mms::VectorBuilder<Ptr> builder(w), std::logic_error);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2011-2014 Dmitry Prokoptsev <dprokoptsev@yandex-team.ru>
+ *
+ * This file is part of mms, the memory-mapped storage library.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <mms/vector.h>
+#include <mms/string.h>
+#include <mms/map.h>
+#include <mms/unordered_map.h>
+
+#include <sstream>
+
+// A structure with a bit of everything, shared by tests which rewrite
+// whole files (compaction, parallel writes)
+
+template<class P>
+struct Record {
+    int id;
+    mms::string<P> name;
+    mms::vector< P, mms::vector<P, int> > values;
+    mms::vector< P, mms::string<P> > tags;
+
+    template<class A> void traverseFields(A a) const
+    {
+        a(id)(mms::field("name", name))(mms::field("values", values))(mms::field("tags", tags));
+    }
+};
+
+template<class P>
+struct Index {
+    mms::string<P> title;  // leaves data position unaligned
+    mms::vector< P, Record<P> > records;
+    mms::map< P, mms::string<P>, int > byName;
+    mms::unordered_map< P, int, mms::string<P> > byId;
+    mms::vector<P, char> chars;
+
+    template<class A> void traverseFields(A a) const
+    {
+        a(mms::field("title", title))(mms::field("records", records))
+         (mms::field("byName", byName))(mms::field("byId", byId))(mms::field("chars", chars));
+    }
+};
+
+inline Index<mms::Standalone> genIndex(size_t size)
+{
+    Index<mms::Standalone> idx;
+    idx.title = "index";
+    for (size_t i = 0; i != size; ++i) {
+        std::ostringstream name;
+        name << "record #" << i % 10;
+        Record<mms::Standalone> r;
+        r.id = i;
+        r.name = name.str();
+        r.values.resize(i % 3);
+        for (size_t j = 0; j != r.values.size(); ++j)
+            r.values[j].assign(j + 1, i);
+        for (size_t j = 0; j != i % 3; ++j)
+            r.tags.push_back(std::string(j + i % 7, 'x'));
+        idx.records.push_back(r);
+        idx.byName[name.str()] = i;
+        idx.byId[i] = name.str();
+        idx.chars.push_back('a' + i % 26);
+    }
+    return idx;
+}
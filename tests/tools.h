@@ -31,6 +31,7 @@
 #include <mms/vector.h>
 #include <mms/string.h>
 #include <mms/set.h>
+#include <mms/map.h>
 #include <mms/string.h>
 
 #include <boost/ptr_container/ptr_vector.hpp>
@@ -38,8 +39,16 @@
 #include <boost/type_traits/remove_reference.hpp>
 #include <boost/mpl/bool.hpp>
 
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
 #include <functional>
+#include <iterator>
 #include <sstream>
+#include <string>
+
+#include <stdlib.h>
+#include <unistd.h>
 
 inline boost::ptr_vector<std::string>& allStrings()
 {
@@ -152,6 +161,87 @@ inline std::map<K, V> genMap(int seed, size_t size)
     return result;
 }
 
+inline mms::vector< mms::Standalone, mms::string<mms::Standalone> > genStrings(size_t size)
+{
+    mms::vector< mms::Standalone, mms::string<mms::Standalone> > result;
+    for (size_t i = 0; i != size; ++i)
+        result.push_back(std::string(i % 17, 'a' + i % 26));
+    return result;
+}
+
+template<class P>
+struct Doc {
+    int id;
+    mms::string<P> title;
+    mms::vector<P, int> body;
+    mms::map<P, mms::string<P>, mms::vector<P, double> > attrs;
+
+    template<class A> void traverseFields(A a) const { a(id)(title)(body)(attrs); }
+};
+
+inline Doc<mms::Standalone> genDoc(size_t bodySize)
+{
+    Doc<mms::Standalone> d;
+    d.id = 17;
+    d.title = std::string(bodySize / 3 + 1, 't');
+    for (size_t i = 0; i != bodySize; ++i)
+        d.body.push_back(i * 7);
+    for (size_t i = 0; i != 50; ++i)
+        d.attrs[std::string(i + 1, 'a' + i % 26)].assign(i % 5, i * 0.25);
+    return d;
+}
+
+template<class T>
+inline std::string serialize(const T& t)
+{
+    std::ostringstream out;
+    mms::safeWrite(out, t);
+    return out.str();
+}
+
+// Reads the whole file, leaving its offset intact
+inline std::string readAll(int fd)
+{
+    std::string result;
+    char buf[4096];
+    for (ssize_t n, ofs = 0; (n = pread(fd, buf, sizeof(buf), ofs)) > 0; ofs += n)
+        result.append(buf, n);
+    return result;
+}
+
+// A temporary file, removed on destruction
+class TempFile {
+public:
+    TempFile()
+    {
+        char name[] = "/tmp/mms_test.XXXXXX";
+        int fd = mkstemp(name);
+        BOOST_REQUIRE(fd >= 0);
+        close(fd);
+        path_ = name;
+    }
+
+    ~TempFile() { unlink(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+
+    template<class T>
+    void write(const T& t)
+    {
+        std::ofstream out(path_.c_str());
+        mms::safeWrite(out, t);
+    }
+
+    std::string read() const
+    {
+        std::ifstream in(path_.c_str());
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+private:
+    std::string path_;
+};
+
 template <class T>
 struct LexicographicalCompare
     :public std::binary_function<T, T, bool>